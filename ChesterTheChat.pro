@@ -1,4 +1,4 @@
-QT       += core gui network sql
+QT       += core gui network sql concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -25,34 +25,57 @@ FORMS += \
 
 HEADERS += \
     ../Utils/debugmacros.h \
+    src/ChatMessageDelegate/chatmessagedelegate.h \
+    src/ChatMessageModel/chatmessagemodel.h \
     src/ChatPager/chatpager.h \
+    src/ChatView/chatview.h \
     src/DemoChatSimulator/demochatsimulator.h \
+    src/HistoryTransfer/historytransfer.h \
+    src/IncomingMessageQueue/incomingmessagequeue.h \
     src/InstanceIdManager/instanceidmanager.h \
+    src/LogMessageStore/logmessagestore.h \
     src/MainWindow/mainwindow.h \
+    src/MessageBatch/messagebatch.h \
+    src/MessagePageCache/messagepagecache.h \
+    src/MessageStorage/messagestorage.h \
     src/StyleManager/stylemanager.h \
     src/features.h \
     src/MessageStore/messagestore.h \
     src/ChatFormatter/chatformatter.h \
     src/globals.h \
     src/SettingsManager/settingsmanager.h \
+    src/SqliteReadPool/sqlitereadpool.h \
     src/StyleRotator/stylerotator.h \
     src/UDPChatSocketManager/udpchatsocketmanager.h \
+    src/UserDirectory/userdirectory.h \
     src/version.h \
     src/ToastNotification/toastnotification.h \
+    structures.h \
     todo.h
 
 SOURCES += \
+    src/ChatMessageDelegate/chatmessagedelegate.cpp \
+    src/ChatMessageModel/chatmessagemodel.cpp \
     src/ChatPager/chatpager.cpp \
+    src/ChatView/chatview.cpp \
     src/DemoChatSimulator/demochatsimulator.cpp \
+    src/HistoryTransfer/historytransfer.cpp \
+    src/IncomingMessageQueue/incomingmessagequeue.cpp \
     src/InstanceIdManager/instanceidmanager.cpp \
+    src/LogMessageStore/logmessagestore.cpp \
+    src/MessageBatch/messagebatch.cpp \
+    src/MessagePageCache/messagepagecache.cpp \
+    src/MessageStorage/messagestorage.cpp \
     src/MessageStore/messagestore.cpp \
     src/ChatFormatter/chatformatter.cpp \
     src/StyleManager/stylemanager.cpp \
     src/main.cpp \
     src/MainWindow/mainwindow.cpp \
     src/SettingsManager/settingsmanager.cpp \
+    src/SqliteReadPool/sqlitereadpool.cpp \
     src/StyleRotator/stylerotator.cpp \
     src/UDPChatSocketManager/udpchatsocketmanager.cpp \
+    src/UserDirectory/userdirectory.cpp \
     src/ToastNotification/toastnotification.cpp
 
 DISTFILES += \
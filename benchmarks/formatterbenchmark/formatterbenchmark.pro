@@ -0,0 +1,22 @@
+QT       += core gui widgets
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = formatterbenchmark
+
+# Builds the formatter straight from the application sources.
+ROOT = $$PWD/../..
+INCLUDEPATH += $$ROOT/
+
+HEADERS += \
+    $$ROOT/src/ChatFormatter/chatformatter.h \
+    $$ROOT/src/MessageBatch/messagebatch.h \
+    $$ROOT/src/UserDirectory/userdirectory.h \
+    $$ROOT/structures.h
+
+SOURCES += \
+    main.cpp \
+    $$ROOT/src/ChatFormatter/chatformatter.cpp \
+    $$ROOT/src/MessageBatch/messagebatch.cpp \
+    $$ROOT/src/UserDirectory/userdirectory.cpp
@@ -0,0 +1,189 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Chat formatter benchmark.
+ *
+ * Renders the same synthetic history into one QTextDocument per message, the
+ * way the chat view's delegate does, and reports messages per second:
+ *  - per-message formats: block and character formats built for every message,
+ *    the margin recomputed and the theme detected from the style sheet string,
+ *    as the formatter did before it cached its formats
+ *  - cached formats: ChatFormatter::formatMessage()
+ *
+ * Each path is timed once formatting only and once including document layout.
+ *
+ * Usage: formatterbenchmark [messageCount]
+ */
+
+#include "src/ChatFormatter/chatformatter.h"
+#include "src/MessageBatch/messagebatch.h"
+#include "src/UserDirectory/userdirectory.h"
+
+#include <QAbstractTextDocumentLayout>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QTextDocument>
+#include <QTextStream>
+
+#include <functional>
+
+namespace {
+
+constexpr int kDefaultMessageCount = 10000;
+constexpr int kViewportWidth = 900;
+constexpr int kUserCount = 8;
+
+// A theme sheet of typical length; the old formatter searched it once per message.
+const QString kStyleSheet = QStringLiteral("QLineEdit, QTextEdit, ChatView {\n    background-color: #1A1A1A;\n"
+                                           "    color: #F8F8F2;\n    border: 1px solid #8B0000;\n}\n"
+                                           "QTextEdit#textEditChat { color: white; }\n");
+
+MessageBatch makeBatch(int count, UserDirectory &users)
+{
+    static const QStringList names = {"Chester", "Alice", "Bob", "Mallory", "Trent", "Peggy", "Victor", "Walter"};
+    for (int i = 0; i < kUserCount; ++i)
+        users.insert(i + 1, names.at(i));
+
+    MessageBatch batch;
+    batch.reserve(count);
+
+    const qint64 start = 1700000000000;
+    for (int i = 0; i < count; ++i) {
+        const QString text = QString("Message %1 - the quick brown fox jumps over the lazy dog").arg(i);
+        const int userId = (i / 3) % kUserCount + 1; // short runs by the same sender
+        batch.append(i + 1, userId, text, start + i * 1000, userId == 1 ? MessageBatch::SentByMe : 0);
+    }
+    return batch;
+}
+
+// The per-message path the formatter used before caching its formats.
+void formatUncached(QTextDocument *document, const MessageBatch &batch, int row, bool showUserName, const UserDirectory &users)
+{
+    const bool isSent = batch.isSentByMe(row);
+
+    QTextCursor cursor(document);
+
+    QTextBlockFormat blockFmt;
+    blockFmt.setAlignment(isSent ? Qt::AlignRight : Qt::AlignLeft);
+    const int margin = static_cast<int>(kViewportWidth * BORDER_MARGIN);
+    if (isSent) {
+        blockFmt.setLeftMargin(margin);
+        blockFmt.setRightMargin(10);
+    } else {
+        blockFmt.setRightMargin(margin);
+    }
+    cursor.setBlockFormat(blockFmt);
+
+    const QString message = batch.text(row).toString();
+
+    if (showUserName) {
+        QTextCharFormat userFmt;
+        userFmt.setForeground(isSent ? QColor(QColorConstants::Cyan) : users.color(batch.userId(row)));
+        userFmt.setFontWeight(QFont::Bold);
+        userFmt.setFontPointSize(11);
+        cursor.insertText("\n" + users.name(batch.userId(row)) + "\n", userFmt);
+
+        QTextCharFormat bodyFmt;
+        bodyFmt.setFontPointSize(14);
+        cursor.insertText(message + "\n", bodyFmt);
+    } else {
+        QTextCharFormat bodyFmt;
+        bodyFmt.setFontPointSize(14);
+        cursor.insertText("\n" + message + "\n", bodyFmt);
+    }
+
+    const bool isDark = kStyleSheet.simplified().contains("QTextEdit#textEditChat { color: black;}");
+
+    QTextCharFormat timeFmt;
+    timeFmt.setForeground(isDark ? Qt::gray : Qt::darkGray);
+    QFont f = document->defaultFont();
+    f.setPointSize(10);
+    timeFmt.setFont(f);
+    cursor.insertText(batch.timestamp(row).toString("hh:mmZ"), timeFmt);
+}
+
+using FormatFunction = std::function<void(QTextDocument *, int, bool)>;
+
+double run(const MessageBatch &batch, bool withLayout, const FormatFunction &format)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int row = 0; row < batch.size(); ++row) {
+        QTextDocument document;
+        document.setUndoRedoEnabled(false);
+        document.setTextWidth(kViewportWidth);
+
+        const bool showUserName = row == 0 || batch.userId(row) != batch.userId(row - 1);
+        format(&document, row, showUserName);
+
+        if (withLayout)
+            document.documentLayout()->documentSize();
+    }
+
+    const qint64 nsecs = timer.nsecsElapsed();
+    return nsecs > 0 ? batch.size() * 1e9 / nsecs : 0.0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // Text layout needs a GUI application, not a screen.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const QStringList args = app.arguments();
+    const int messageCount = args.size() > 1 ? qMax(1, args.at(1).toInt()) : kDefaultMessageCount;
+
+    UserDirectory users;
+    const MessageBatch batch = makeBatch(messageCount, users);
+
+    ChatFormatter formatter;
+    formatter.setUserDirectory(&users);
+
+    const FormatFunction uncached = [&](QTextDocument *document, int row, bool showUserName) {
+        formatUncached(document, batch, row, showUserName, users);
+    };
+    const FormatFunction cached = [&](QTextDocument *document, int row, bool showUserName) {
+        formatter.formatMessage(document, batch, row, showUserName, kViewportWidth);
+    };
+
+    out << "Formatter benchmark: " << messageCount << " messages, viewport width " << kViewportWidth << "\n";
+
+    for (const bool withLayout : {false, true}) {
+        // Warm up fonts and glyph caches so the first timed path is not penalised.
+        run(batch, withLayout, cached);
+
+        const double before = run(batch, withLayout, uncached);
+        const double after = run(batch, withLayout, cached);
+
+        out << QString("%1 per-message formats %2 msg/s | cached formats %3 msg/s | %4x\n")
+                   .arg(withLayout ? "format + layout:" : "format only:    ")
+                   .arg(before, 10, 'f', 0)
+                   .arg(after, 10, 'f', 0)
+                   .arg(before > 0 ? after / before : 0.0, 0, 'f', 2);
+        out.flush();
+    }
+
+    return 0;
+}
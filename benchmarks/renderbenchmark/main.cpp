@@ -0,0 +1,337 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Headless rendering benchmark.
+ *
+ * Stores a synthetic history per corpus (short, medium and long messages) in a
+ * log backend and drives the chat rendering pipeline over it offscreen:
+ *  - format: ChatFormatter::formatMessage() into one document per message,
+ *    timed separately from the document layout that follows
+ *  - pages: the chat view jumps to random rows with an empty document cache
+ *    and renders a full screen, the way a page was rebuilt on every jump
+ *  - theme switches: the view flips between a light and a dark palette and
+ *    renders the screen again, reusing the cached documents
+ *
+ * Results are printed and written as JSON, together with the peak resident
+ * memory of the process, so runs of different builds can be compared.
+ *
+ * Usage: renderbenchmark [messageCount] [output.json]
+ */
+
+#include "src/ChatFormatter/chatformatter.h"
+#include "src/ChatMessageDelegate/chatmessagedelegate.h"
+#include "src/ChatMessageModel/chatmessagemodel.h"
+#include "src/ChatPager/chatpager.h"
+#include "src/ChatView/chatview.h"
+#include "src/MessageStorage/messagestorage.h"
+
+#include <QAbstractTextDocumentLayout>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTextDocument>
+#include <QTextStream>
+#include <QTimeZone>
+
+#include <memory>
+
+namespace {
+
+constexpr int kDefaultMessageCount = 20000;
+constexpr int kBatchSize = 5000;
+constexpr int kViewWidth = 900;
+constexpr int kViewHeight = 700;
+constexpr int kPageJumps = 50;
+constexpr int kThemeSwitches = 20;
+constexpr int kMaxLoadRounds = 100;
+
+/**
+ * @brief A synthetic history whose messages repeat a sentence @p repeats times.
+ */
+struct Corpus {
+    const char *name;
+    int repeats;
+};
+
+const Corpus kCorpora[] = {
+    {"short", 1},
+    {"medium", 4},
+    {"long", 20},
+};
+
+QList<Message> makeBatch(int first, int count, int repeats)
+{
+    static const QStringList users = {"Chester", "Alice", "Bob", "Mallory", "Trent", "Peggy", "Victor", "Walter"};
+    const QDateTime start = QDateTime::fromSecsSinceEpoch(1700000000, QTimeZone::UTC);
+
+    QList<Message> batch;
+    batch.reserve(count);
+
+    for (int i = first; i < first + count; ++i) {
+        Message m;
+        m.user = users.at((i / 3) % users.size()); // short runs by the same sender
+        m.text = QString("Message %1 -").arg(i) + QString(" the quick brown fox jumps over the lazy dog.").repeated(repeats);
+        m.timestamp = start.addSecs(i);
+        m.isSentByMe = m.user == users.first();
+        batch.append(m);
+    }
+    return batch;
+}
+
+double perSecond(qint64 operations, qint64 nsecs)
+{
+    return nsecs > 0 ? operations * 1e9 / nsecs : 0.0;
+}
+
+double msecs(qint64 nsecs, qint64 count = 1)
+{
+    return count > 0 ? nsecs / 1e6 / count : 0.0;
+}
+
+/// Returns the peak resident set size of the process in KiB, or -1 where unknown.
+qint64 peakMemoryKiB()
+{
+#ifdef Q_OS_LINUX
+    QFile status("/proc/self/status");
+    if (status.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        const QList<QByteArray> lines = status.readAll().split('\n');
+        for (const QByteArray &line : lines) {
+            if (line.startsWith("VmHWM:"))
+                return line.mid(6).trimmed().split(' ').first().toLongLong();
+        }
+    }
+#endif
+    return -1;
+}
+
+QJsonObject benchmarkFormat(ChatFormatter &formatter, const MessageBatch &batch)
+{
+    qint64 formatNs = 0;
+    qint64 layoutNs = 0;
+    qint64 characters = 0;
+    QElapsedTimer timer;
+
+    for (int row = 0; row < batch.size(); ++row) {
+        QTextDocument document;
+        document.setUndoRedoEnabled(false);
+        document.setTextWidth(kViewWidth);
+
+        const bool showUserName = row == 0 || batch.userId(row) != batch.userId(row - 1);
+
+        timer.start();
+        formatter.formatMessage(&document, batch, row, showUserName, kViewWidth);
+        formatNs += timer.nsecsElapsed();
+
+        timer.start();
+        document.documentLayout()->documentSize();
+        layoutNs += timer.nsecsElapsed();
+
+        characters += batch.text(row).size();
+    }
+
+    QJsonObject result;
+    result["messagesPerSecond"] = perSecond(batch.size(), formatNs + layoutNs);
+    result["formatMsPerMessage"] = msecs(formatNs, batch.size());
+    result["layoutMsPerMessage"] = msecs(layoutNs, batch.size());
+    result["averageCharacters"] = batch.size() > 0 ? double(characters) / batch.size() : 0.0;
+    return result;
+}
+
+/// Reads pending pages until every row on screen is present, then renders the screen.
+void renderScreen(ChatView &view, const ChatMessageModel &model, QImage &image)
+{
+    for (int round = 0; round < kMaxLoadRounds; ++round) {
+        QCoreApplication::processEvents();
+        view.viewport()->render(&image);
+
+        bool isComplete = true;
+        MessageBatchPtr batch;
+        int position = 0;
+        for (int row = view.firstVisibleRow(); row >= 0 && row <= view.lastVisibleRow(); ++row) {
+            if (model.messageAt(row, batch, position) == ChatMessageModel::RowState::Pending) {
+                isComplete = false;
+                break;
+            }
+        }
+        if (isComplete)
+            return;
+    }
+}
+
+QJsonObject benchmarkView(MessageStorage *store, ChatFormatter &formatter, QJsonObject &themeResult)
+{
+    ChatPager pager(store);
+    pager.reload();
+    ChatMessageModel model(&pager);
+    ChatMessageDelegate delegate(&formatter);
+
+    ChatView view;
+    view.setItemDelegate(&delegate);
+    view.setModel(&model);
+    view.resize(kViewWidth, kViewHeight);
+    view.show();
+
+    QImage image(view.viewport()->size(), QImage::Format_ARGB32_Premultiplied);
+    QRandomGenerator random(42);
+    QElapsedTimer timer;
+
+    qint64 pageNs = 0;
+    qint64 slowestPageNs = 0;
+    int rowsShown = 0;
+
+    for (int jump = 0; jump < kPageJumps; ++jump) {
+        const int row = random.bounded(model.rowCount());
+
+        timer.start();
+        delegate.invalidate(); // every page is formatted from scratch
+        view.scrollTo(model.index(row), QAbstractItemView::PositionAtTop);
+        renderScreen(view, model, image);
+        const qint64 elapsed = timer.nsecsElapsed();
+
+        pageNs += elapsed;
+        slowestPageNs = qMax(slowestPageNs, elapsed);
+        rowsShown += view.lastVisibleRow() - view.firstVisibleRow() + 1;
+    }
+
+    QPalette light = view.palette();
+    light.setColor(QPalette::Base, Qt::white);
+    light.setColor(QPalette::Text, Qt::black);
+    QPalette dark = light;
+    dark.setColor(QPalette::Base, QColor(0x1A, 0x1A, 0x1A));
+    dark.setColor(QPalette::Text, QColor(0xF8, 0xF8, 0xF2));
+
+    qint64 themeNs = 0;
+    for (int i = 0; i < kThemeSwitches; ++i) {
+        timer.start();
+        view.setPalette(i % 2 == 0 ? dark : light);
+        view.invalidateRowHeights();
+        renderScreen(view, model, image);
+        themeNs += timer.nsecsElapsed();
+    }
+
+    themeResult["switches"] = kThemeSwitches;
+    themeResult["msPerSwitch"] = msecs(themeNs, kThemeSwitches);
+
+    QJsonObject result;
+    result["pages"] = kPageJumps;
+    result["msPerPage"] = msecs(pageNs, kPageJumps);
+    result["slowestPageMs"] = msecs(slowestPageNs);
+    result["rowsPerPage"] = double(rowsShown) / kPageJumps;
+    return result;
+}
+
+bool runCorpus(const Corpus &corpus, int messageCount, QJsonObject &result, QTextStream &out)
+{
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        out << "Cannot create a temporary directory\n";
+        return false;
+    }
+
+    std::unique_ptr<MessageStorage> store(MessageStorage::create(MessageStorage::kLogBackend, dir.path(), 1, nullptr));
+    if (!store->open()) {
+        out << corpus.name << ": open failed\n";
+        return false;
+    }
+
+    for (int first = 0; first < messageCount; first += kBatchSize) {
+        if (!store->insertMessages(makeBatch(first, qMin(kBatchSize, messageCount - first), corpus.repeats))) {
+            out << corpus.name << ": insert failed\n";
+            return false;
+        }
+    }
+
+    ChatFormatter formatter;
+    formatter.setUserDirectory(&store->users());
+
+    const MessageBatchPtr batch = store->fetchMessageRange(store->firstMessageId(), store->lastMessageId());
+
+    // Warm up fonts and glyph caches so the first timed pass is not penalised.
+    benchmarkFormat(formatter, *batch);
+
+    QJsonObject themes;
+    const QJsonObject format = benchmarkFormat(formatter, *batch);
+    const QJsonObject pages = benchmarkView(store.get(), formatter, themes);
+
+    result["corpus"] = corpus.name;
+    result["messages"] = messageCount;
+    result["format"] = format;
+    result["pageRebuilds"] = pages;
+    result["themeSwitches"] = themes;
+
+    out << QString("%1 %2 msg/s (format %3 ms + layout %4 ms per message) | page %5 ms (slowest %6 ms) | theme switch %7 ms\n")
+               .arg(corpus.name, -6)
+               .arg(format["messagesPerSecond"].toDouble(), 9, 'f', 0)
+               .arg(format["formatMsPerMessage"].toDouble(), 0, 'f', 3)
+               .arg(format["layoutMsPerMessage"].toDouble(), 0, 'f', 3)
+               .arg(pages["msPerPage"].toDouble(), 0, 'f', 2)
+               .arg(pages["slowestPageMs"].toDouble(), 0, 'f', 2)
+               .arg(themes["msPerSwitch"].toDouble(), 0, 'f', 2);
+    out.flush();
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // Text layout and widgets need a GUI application, not a screen.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const QStringList args = app.arguments();
+    const int messageCount = args.size() > 1 ? qMax(kBatchSize, args.at(1).toInt()) : kDefaultMessageCount;
+    const QString jsonPath = args.size() > 2 ? args.at(2) : QStringLiteral("renderbenchmark.json");
+
+    out << "Render benchmark: " << messageCount << " messages per corpus, view " << kViewWidth << "x" << kViewHeight << "\n";
+
+    bool ok = true;
+    QJsonArray corpora;
+    for (const Corpus &corpus : kCorpora) {
+        QJsonObject result;
+        ok = runCorpus(corpus, messageCount, result, out) && ok;
+        corpora.append(result);
+    }
+
+    QJsonObject report;
+    report["qtVersion"] = QString::fromLatin1(qVersion());
+    report["platform"] = QGuiApplication::platformName();
+    report["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    report["corpora"] = corpora;
+    report["peakMemoryKiB"] = peakMemoryKiB();
+
+    QFile file(jsonPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        out << "Cannot write " << jsonPath << "\n";
+        return 1;
+    }
+    file.write(QJsonDocument(report).toJson());
+
+    out << "Peak memory " << report["peakMemoryKiB"].toInteger() << " KiB, results written to " << jsonPath << "\n";
+    return ok ? 0 : 1;
+}
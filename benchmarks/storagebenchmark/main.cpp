@@ -0,0 +1,155 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Storage backend benchmark.
+ *
+ * Fills each MessageStorage backend with the same synthetic history and reports
+ * append and read throughput:
+ *  - batch append: insertMessages() in batches of kBatchSize
+ *  - single append: insertMessage() one row at a time (live chat traffic)
+ *  - page reads: random fetchMessagesBefore() pages of kPageSize
+ *  - full scan: forEachMessage() over the whole history
+ *
+ * Usage: storagebenchmark [messageCount]
+ */
+
+#include "src/MessageStorage/messagestorage.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimeZone>
+
+#include <memory>
+
+namespace {
+
+constexpr int kDefaultMessageCount = 200000;
+constexpr int kBatchSize = 20000;
+constexpr int kSingleAppends = 5000;
+constexpr int kPageSize = 25;
+constexpr int kPageReads = 20000;
+
+QList<Message> makeBatch(int first, int count)
+{
+    static const QStringList users = {"Chester", "Alice", "Bob", "Mallory", "Trent", "Peggy", "Victor", "Walter"};
+    const QDateTime start = QDateTime::fromSecsSinceEpoch(1700000000, QTimeZone::UTC);
+
+    QList<Message> batch;
+    batch.reserve(count);
+
+    for (int i = first; i < first + count; ++i) {
+        Message m;
+        m.user = users.at(i % users.size());
+        m.text = QString("Message %1 - the quick brown fox jumps over the lazy dog").arg(i);
+        m.timestamp = start.addSecs(i);
+        m.isSentByMe = (i % users.size()) == 0;
+        batch.append(m);
+    }
+    return batch;
+}
+
+double perSecond(qint64 operations, qint64 nsecs)
+{
+    return nsecs > 0 ? operations * 1e9 / nsecs : 0.0;
+}
+
+bool runBackend(const QString &backend, const QString &basePath, int messageCount, QTextStream &out)
+{
+    std::unique_ptr<MessageStorage> store(MessageStorage::create(backend, basePath, 1, nullptr));
+    if (!store->open()) {
+        out << backend << ": open failed\n";
+        return false;
+    }
+
+    QElapsedTimer timer;
+
+    timer.start();
+    for (int first = 0; first < messageCount; first += kBatchSize) {
+        if (!store->insertMessages(makeBatch(first, qMin(kBatchSize, messageCount - first)))) {
+            out << backend << ": batch insert failed\n";
+            return false;
+        }
+    }
+    const qint64 batchNs = timer.nsecsElapsed();
+
+    const QList<Message> singles = makeBatch(messageCount, kSingleAppends);
+    timer.restart();
+    for (const Message &m : singles)
+        store->insertMessage(m.user, m.text, m.timestamp, m.isSentByMe);
+    const qint64 singleNs = timer.nsecsElapsed();
+
+    const qint64 firstId = store->firstMessageId();
+    const qint64 lastId = store->lastMessageId();
+    QRandomGenerator random(42);
+    qint64 pageRows = 0;
+
+    timer.restart();
+    for (int i = 0; i < kPageReads; ++i) {
+        const qint64 beforeId = firstId + kPageSize + random.bounded(lastId - firstId - kPageSize + 1);
+        pageRows += store->fetchMessagesBefore(beforeId, kPageSize)->size();
+    }
+    const qint64 pageNs = timer.nsecsElapsed();
+
+    qint64 scanned = 0;
+    timer.restart();
+    store->forEachMessage([&scanned](const Message &) {
+        ++scanned;
+        return true;
+    });
+    const qint64 scanNs = timer.nsecsElapsed();
+
+    out << QString("%1 batch append %2 msg/s | single append %3 msg/s | page reads %4 pages/s (%5 rows) | full scan %6 msg/s (%7 rows)\n")
+               .arg(backend, -7)
+               .arg(perSecond(messageCount, batchNs), 12, 'f', 0)
+               .arg(perSecond(kSingleAppends, singleNs), 10, 'f', 0)
+               .arg(perSecond(kPageReads, pageNs), 10, 'f', 0)
+               .arg(pageRows)
+               .arg(perSecond(scanned, scanNs), 12, 'f', 0)
+               .arg(scanned);
+    out.flush();
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const QStringList args = app.arguments();
+    const int messageCount = args.size() > 1 ? qMax(kPageSize * 2, args.at(1).toInt()) : kDefaultMessageCount;
+
+    out << "Storage benchmark: " << messageCount << " messages, page size " << kPageSize << "\n";
+
+    bool ok = true;
+    for (const char *backend : {MessageStorage::kSqliteBackend, MessageStorage::kLogBackend}) {
+        QTemporaryDir dir;
+        if (!dir.isValid()) {
+            out << "Cannot create a temporary directory\n";
+            return 1;
+        }
+        ok = runBackend(QString::fromLatin1(backend), dir.path(), messageCount, out) && ok;
+    }
+
+    return ok ? 0 : 1;
+}
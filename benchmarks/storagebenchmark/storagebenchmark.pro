@@ -0,0 +1,30 @@
+QT       += core gui sql concurrent
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = storagebenchmark
+
+# Builds the storage backends straight from the application sources.
+ROOT = $$PWD/../..
+INCLUDEPATH += $$ROOT/
+
+HEADERS += \
+    $$ROOT/src/LogMessageStore/logmessagestore.h \
+    $$ROOT/src/MessageBatch/messagebatch.h \
+    $$ROOT/src/MessagePageCache/messagepagecache.h \
+    $$ROOT/src/MessageStorage/messagestorage.h \
+    $$ROOT/src/MessageStore/messagestore.h \
+    $$ROOT/src/SqliteReadPool/sqlitereadpool.h \
+    $$ROOT/src/UserDirectory/userdirectory.h \
+    $$ROOT/structures.h
+
+SOURCES += \
+    main.cpp \
+    $$ROOT/src/LogMessageStore/logmessagestore.cpp \
+    $$ROOT/src/MessageBatch/messagebatch.cpp \
+    $$ROOT/src/MessagePageCache/messagepagecache.cpp \
+    $$ROOT/src/MessageStorage/messagestorage.cpp \
+    $$ROOT/src/MessageStore/messagestore.cpp \
+    $$ROOT/src/SqliteReadPool/sqlitereadpool.cpp \
+    $$ROOT/src/UserDirectory/userdirectory.cpp
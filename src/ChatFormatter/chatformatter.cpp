@@ -17,10 +17,13 @@
  */
 
 #include "chatformatter.h"
+#include "../MessageBatch/messagebatch.h"
+#include "../UserDirectory/userdirectory.h"
 
 
 #include "qapplication.h"
 #include "qtextcursor.h"
+#include "qtextdocument.h"
 
 #include "../Utils/debugmacros.h"
 
@@ -29,151 +32,242 @@ ChatFormatter::ChatFormatter(QObject *parent)
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
+    rebuildCharFormats();
 }
 
-int ChatFormatter::calculateDynamicMargin(QTextEdit *textEdit, double percent, int fallback) const
+void ChatFormatter::rebuildCharFormats()
 {
-    //LOG_DEBUG(Q_FUNC_INFO);
+    LOG_DEBUG(Q_FUNC_INFO);
 
-    if (!textEdit || !textEdit->viewport())
-        return fallback;
+    m_bodyFormat = QTextCharFormat();
+    m_bodyFormat.setFontPointSize(14);
 
-    int editorWidth = textEdit ? textEdit->viewport()->width() : fallback;
-    return static_cast<int>(editorWidth * percent);
-} //calculateDynamicMargin
+    // Only the point size is set, so the family follows the document's default font.
+    m_timestampFormat = themeFormat(TextRole::Timestamp);
+    m_timestampFormat.setProperty(kTextRoleProperty, int(TextRole::Timestamp));
+    m_timestampFormat.setFontPointSize(10);
+} //rebuildCharFormats
 
-void ChatFormatter::insertBlock(QTextEdit * textEdit, QTextCursor &cursor, bool isSent)
+void ChatFormatter::updateBlockFormats(int viewportWidth)
 {
     // LOG_DEBUG(Q_FUNC_INFO);
 
-    QTextBlockFormat blockFmt;
-    blockFmt.setAlignment(isSent ? Qt::AlignRight : Qt::AlignLeft);
+    if (viewportWidth == m_blockFormatWidth)
+        return;
 
-    int margin = calculateDynamicMargin(textEdit, BORDER_MARGIN, 600);
+    m_blockFormatWidth = viewportWidth;
+    const int margin = calculateDynamicMargin(viewportWidth, BORDER_MARGIN, 600);
 
-    if (isSent) {
-        blockFmt.setLeftMargin(margin);
-        blockFmt.setRightMargin(10);
-    } else {
-        blockFmt.setRightMargin(margin);
-    }
+    m_sentBlockFormat = QTextBlockFormat();
+    m_sentBlockFormat.setAlignment(Qt::AlignRight);
+    m_sentBlockFormat.setLeftMargin(margin);
+    m_sentBlockFormat.setRightMargin(10);
 
-    cursor.insertBlock(blockFmt);
-} //insertBlock
+    m_receivedBlockFormat = QTextBlockFormat();
+    m_receivedBlockFormat.setAlignment(Qt::AlignLeft);
+    m_receivedBlockFormat.setRightMargin(margin);
+} //updateBlockFormats
 
-QColor ChatFormatter::generateUserColor(const QString &user)
+const QTextCharFormat &ChatFormatter::senderFormat(const QColor &color)
 {
     // LOG_DEBUG(Q_FUNC_INFO);
 
-    if (!userColorMap.contains(user)) {
-        userColorMap.insert(user, generateColorForUser(user));
+    auto it = m_senderFormats.find(color.rgba());
+    if (it == m_senderFormats.end()) {
+        QTextCharFormat fmt;
+        fmt.setForeground(color);
+        fmt.setFontWeight(QFont::Bold);
+        fmt.setFontPointSize(11);
+        it = m_senderFormats.insert(color.rgba(), fmt);
     }
-    return userColorMap.value(user);
-}
+    return it.value();
+} //senderFormat
+
+int ChatFormatter::calculateDynamicMargin(int viewportWidth, double percent, int fallback) const
+{
+    //LOG_DEBUG(Q_FUNC_INFO);
+
+    if (viewportWidth <= 0)
+        return fallback;
 
-QColor ChatFormatter::resolveUserColor(const QString &user, bool isSent)
+    return static_cast<int>(viewportWidth * percent);
+} //calculateDynamicMargin
+
+QColor ChatFormatter::generateUserColor(const QString &user)
 {
     // LOG_DEBUG(Q_FUNC_INFO);
 
-    return isSent ? QColorConstants::Cyan : generateUserColor(user);
+    if (m_users) {
+        const int userId = m_users->idForName(user);
+        if (userId > 0)
+            return m_users->color(userId);
+    }
+
+    auto it = userColorMap.constFind(user);
+    if (it == userColorMap.constEnd())
+        it = userColorMap.insert(user, generateColorForUser(user));
+    return it.value();
 }
 
-void ChatFormatter::insertUserLine(QTextCursor &cursor, const QString &user, const QColor &color)
+void ChatFormatter::setDarkTheme(bool isDark)
 {
-    // LOG_DEBUG(Q_FUNC_INFO);
+    if (isDark == m_isDark)
+        return;
 
+    m_isDark = isDark;
+    ++m_themeSerial;
+    rebuildCharFormats();
+} //setDarkTheme
+
+QTextCharFormat ChatFormatter::themeFormat(TextRole role) const
+{
     QTextCharFormat fmt;
-    fmt.setForeground(color);
-    fmt.setFontWeight(QFont::Bold);
-    fmt.setFontPointSize(11);
 
-    cursor.insertText("\n" + user + "\n", fmt);
-} //insertUserLine
+    if (role == TextRole::Timestamp)
+        fmt.setForeground(m_isDark ? Qt::gray : Qt::darkGray);
+
+    return fmt;
+} //themeFormat
 
-void ChatFormatter::insertMessageLine(QTextCursor &cursor, const QString &message)
+void ChatFormatter::applyTheme(QTextDocument *document) const
 {
     // LOG_DEBUG(Q_FUNC_INFO);
 
-    QTextCharFormat fmt;
-    fmt.setFontPointSize(14);
+    struct Span {
+        int position;
+        int length;
+        TextRole role;
+    };
+
+    // Collect first: merging formats may split or join the fragments being walked.
+    QList<Span> spans;
+    for (QTextBlock block = document->begin(); block.isValid(); block = block.next()) {
+        for (QTextBlock::iterator it = block.begin(); !it.atEnd(); ++it) {
+            const QTextFragment fragment = it.fragment();
+            const int role = fragment.charFormat().intProperty(kTextRoleProperty);
+            if (role != 0)
+                spans.append({fragment.position(), fragment.length(), TextRole(role)});
+        }
+    }
 
-    cursor.insertText(message + "\n", fmt);
-} //insertMessageLine
+    QTextCursor cursor(document);
+    for (const Span &span : std::as_const(spans)) {
+        const QTextCharFormat fmt = themeFormat(span.role);
+        cursor.setPosition(span.position);
+        cursor.setPosition(span.position + span.length, QTextCursor::KeepAnchor);
+        cursor.mergeCharFormat(fmt);
+    }
+} //applyTheme
 
-void ChatFormatter::insertTimestampLine(QTextCursor &cursor, const QDateTime &ts, const QFont &baseFont, const bool &isDark)
+void ChatFormatter::applyViewportWidth(QTextDocument *document, int viewportWidth)
 {
     // LOG_DEBUG(Q_FUNC_INFO);
 
-    QTextCharFormat fmt;
-    fmt.setForeground(isDark ? Qt::gray : Qt::darkGray);
+    updateBlockFormats(viewportWidth);
 
-    QFont f = baseFont;
-    f.setPointSize(10);
-    fmt.setFont(f);
+    // Every block of a message shares its alignment; it tells sent from received.
+    QTextCursor cursor(document);
+    const bool isSent = cursor.blockFormat().alignment() & Qt::AlignRight;
+    const QTextBlockFormat &blockFormat = isSent ? m_sentBlockFormat : m_receivedBlockFormat;
 
-    cursor.insertText(ts.toString("hh:mmZ"), fmt);
-} //insertTimestampLine
+    cursor.beginEditBlock();
+    for (QTextBlock block = document->begin(); block.isValid(); block = block.next()) {
+        if (block.blockFormat() == blockFormat)
+            continue;
+        QTextCursor blockCursor(block);
+        blockCursor.setBlockFormat(blockFormat);
+    }
+    cursor.endEditBlock();
 
-void ChatFormatter::appendMessage(QTextEdit *textEdit, const QString &user, const QString &message, const QDateTime &timestamp, bool isSent)
+    document->setTextWidth(viewportWidth);
+} //applyViewportWidth
+
+void ChatFormatter::insertUserLine(QTextCursor &cursor, const QString &user, const QTextCharFormat &format)
 {
-    LOG_DEBUG(Q_FUNC_INFO);
+    // LOG_DEBUG(Q_FUNC_INFO);
 
-    QTextCursor cursor(textEdit->document());
-    cursor.movePosition(QTextCursor::End);
+    cursor.insertText("\n" + user + "\n", format);
+} //insertUserLine
 
-    const QColor userColor = resolveUserColor(user, isSent);
+void ChatFormatter::insertMessageLine(QTextCursor &cursor, const QString &message, const QTextCharFormat &format)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
 
-    if (!user.isEmpty()) {
-        insertBlock(textEdit, cursor, isSent);
-        insertUserLine(cursor, user, userColor);
-        insertMessageLine(cursor, message);
-    } else {
-        insertMessageLine(cursor, "\n" + message);
-    }
+    cursor.insertText(message + "\n", format);
+} //insertMessageLine
 
-    QString styleSheet = textEdit->styleSheet();
+void ChatFormatter::insertTimestampLine(QTextCursor &cursor, const QDateTime &ts, const QTextCharFormat &format)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
 
-    bool isDark = styleSheet.simplified().contains("QTextEdit#textEditChat { color: black;}");
+    cursor.insertText(ts.toString("hh:mmZ"), format);
+} //insertTimestampLine
 
-    insertTimestampLine(cursor, timestamp, textEdit->font(), isDark);
+void ChatFormatter::formatMessage(QTextDocument *document,
+                                  const MessageBatch &batch,
+                                  int row,
+                                  bool showUserName,
+                                  int viewportWidth)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
 
-    textEdit->setTextCursor(cursor);
-} //appendMessage
+    writePreparedMessage(document, prepareMessage(batch, row, showUserName, viewportWidth));
+} //formatMessage
 
-void ChatFormatter::insertLastReadMarker(QTextEdit *textEdit)
+ChatFormatter::PreparedMessage ChatFormatter::prepareMessage(const MessageBatch &batch,
+                                                             int row,
+                                                             bool showUserName,
+                                                             int viewportWidth)
 {
-    LOG_DEBUG(Q_FUNC_INFO);
-
-    if (!textEdit)
-        return;
+    // LOG_DEBUG(Q_FUNC_INFO);
 
-    QTextCursor cursor = textEdit->textCursor();
-    cursor.movePosition(QTextCursor::End);
+    const int userId = batch.userId(row);
+    const bool isSent = batch.isSentByMe(row);
+    const QString user = m_users ? m_users->name(userId) : QString();
+
+    QColor userColor;
+    if (isSent)
+        userColor = QColorConstants::Cyan;
+    else if (m_users && m_users->contains(userId))
+        userColor = m_users->color(userId);
+    else
+        userColor = generateUserColor(user);
+
+    updateBlockFormats(viewportWidth);
+
+    PreparedMessage message;
+    message.user = showUserName ? user : QString();
+    message.text = batch.text(row).toString();
+    message.timestamp = batch.timestamp(row);
+    message.blockFormat = isSent ? m_sentBlockFormat : m_receivedBlockFormat;
+    if (!message.user.isEmpty())
+        message.senderFormat = senderFormat(userColor);
+    message.bodyFormat = m_bodyFormat;
+    message.timestampFormat = m_timestampFormat;
+    return message;
+} //prepareMessage
+
+void ChatFormatter::writePreparedMessage(QTextDocument *document, const PreparedMessage &message)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
 
-    QTextBlockFormat blockFmt;
-    blockFmt.setAlignment(Qt::AlignHCenter);
-    cursor.insertBlock(blockFmt);
+    // One document per message: format its only block instead of inserting a new one.
+    QTextCursor cursor(document);
+    cursor.setBlockFormat(message.blockFormat);
 
-    QTextCharFormat charFmt;
-    charFmt.setForeground(Qt::red);
-    charFmt.setFontItalic(true);
-    charFmt.setFontPointSize(10);
+    if (!message.user.isEmpty()) {
+        insertUserLine(cursor, message.user, message.senderFormat);
+        insertMessageLine(cursor, message.text, message.bodyFormat);
+    } else {
+        insertMessageLine(cursor, "\n" + message.text, message.bodyFormat);
+    }
 
-    cursor.insertText("──────────── Last Read ────────────\n", charFmt);
-    textEdit->setTextCursor(cursor);
-}//insertLastReadMarker
+    insertTimestampLine(cursor, message.timestamp, message.timestampFormat);
+} //writePreparedMessage
 
 QColor ChatFormatter::generateColorForUser(const QString &user)
 {
     // LOG_DEBUG(Q_FUNC_INFO);
 
-    // deterministic hash → HSV color
-    QByteArray data = user.toUtf8();
-    size_t hash = qHash(data);
-
-    int hue = hash % 360;
-    int sat = 180 + (hash / 360 % 75);
-    int val = 200 + (hash / 10000 % 55);
-
-    return QColor::fromHsv(hue, sat, val);
+    return UserDirectory::colorForName(user);
 } //generateColorForUser
@@ -20,6 +20,7 @@
 #define CHATFORMATTER_H
 
 #include <QObject>
+#include <QHash>
 #include <QMap>
 #include <QColor>
 #include <QString>
@@ -38,22 +39,66 @@
 
 #include "../SettingsManager/settingsmanager.h"
 
+class QTextDocument;
 class QTextEdit;
+class UserDirectory;
+class MessageBatch;
 
 #define BORDER_MARGIN 0.15
 /**
  * @class ChatFormatter
- * @brief Responsible for formatting and inserting chat messages into a QTextEdit.
+ * @brief Responsible for formatting chat messages into rich text documents.
  *
  * ChatFormatter handles text alignment, coloring, and formatting of messages
- * based on whether they are sent or received. It also assigns and caches user-specific
- * colors and adjusts styling based on the theme (dark/light).
+ * based on whether they are sent or received. Each message is written into its
+ * own QTextDocument, which the chat view's delegate lays out and paints. User
+ * colors are taken from the MessageStore's UserDirectory when available.
+ *
+ * Fragments whose look depends on the theme are tagged with a semantic
+ * TextRole. Theme dependent attributes are not baked in per message: they are
+ * resolved from the active theme for each role, and applyTheme() updates an
+ * existing document in place, so a theme switch re-reads and re-formats
+ * nothing. Sender names keep their user's color and the body follows the
+ * view's palette at paint time, so neither is tagged.
+ *
+ * Format objects are built once per theme (character formats) and once per
+ * viewport width (block formats with their margins); formatting a message
+ * only inserts text with the cached formats.
+ *
+ * Formatting is split in two for the chat delegate's layout pool:
+ * prepareMessage() resolves names, colors and formats on the GUI thread, and
+ * writePreparedMessage() writes the result into a document on any thread.
  */
 class ChatFormatter : public QObject
 {
     Q_OBJECT
 
 public:
+    /**
+     * @brief Semantic role of a text fragment, stored under kTextRoleProperty.
+     */
+    enum class TextRole {
+        Timestamp = 1 ///< The time under each message.
+    };
+
+    /// Character format property holding a fragment's TextRole.
+    static constexpr int kTextRoleProperty = QTextFormat::UserProperty + 1;
+
+    /**
+     * @brief A message with everything resolved that formatting needs.
+     *
+     * Holds values only, so it can be handed to another thread.
+     */
+    struct PreparedMessage {
+        QString user;                    ///< Sender line, or empty to continue the previous sender's group.
+        QString text;                    ///< Message body.
+        QDateTime timestamp;             ///< Message timestamp in UTC.
+        QTextBlockFormat blockFormat;    ///< Alignment and side margin.
+        QTextCharFormat senderFormat;    ///< Format of the sender line.
+        QTextCharFormat bodyFormat;      ///< Format of the body.
+        QTextCharFormat timestampFormat; ///< Format of the timestamp.
+    };
+
     ///@name Constructor
     ///@{
     /**
@@ -66,18 +111,74 @@ public:
     ///@name Public Interface
     ///@{
     /**
-     * @brief Appends a formatted chat message to the given QTextEdit.
-     * @param textEdit Pointer to the QTextEdit where the message will be appended.
-     * @param user The name of the user who sent the message.
-     * @param message The content of the message.
-     * @param timestamp The time the message was sent.
-     * @param isSent Whether the message was sent by the local user.
+     * @brief Writes one row of a stored batch into an empty document.
+     *
+     * Name and color are resolved by interned user id.
+     *
+     * @param document Empty document receiving the message; its default font is the base font.
+     * @param batch The batch holding the message.
+     * @param row Index of the message in @p batch.
+     * @param showUserName Whether to print the sender line above the text.
+     * @param viewportWidth Width of the chat viewport, used for the side margin.
+     */
+    void formatMessage(QTextDocument *document,
+                       const MessageBatch &batch,
+                       int row,
+                       bool showUserName,
+                       int viewportWidth);
+
+    /**
+     * @brief Resolves one row of a stored batch for writePreparedMessage().
+     *
+     * Takes the same arguments as formatMessage(). Must run on the GUI thread.
+     */
+    PreparedMessage prepareMessage(const MessageBatch &batch,
+                                   int row,
+                                   bool showUserName,
+                                   int viewportWidth);
+
+    /**
+     * @brief Writes a prepared message into an empty document.
+     *
+     * Touches no formatter state and is safe to call from any thread that
+     * owns @p document.
+     */
+    static void writePreparedMessage(QTextDocument *document, const PreparedMessage &message);
+
+    /**
+     * @brief Selects the light or dark variant of the theme dependent formats.
+     *
+     * Bumps themeSerial() when the variant changes.
+     */
+    void setDarkTheme(bool isDark);
+
+    /// Returns true if the dark variant is active.
+    bool isDarkTheme() const { return m_isDark; }
+
+    /// Returns a counter that changes whenever the theme dependent formats change.
+    quint64 themeSerial() const { return m_themeSerial; }
+
+    /**
+     * @brief Re-resolves the theme dependent formats of a formatted document in place.
+     *
+     * Text, layout relevant attributes and per-user colors are kept.
+     */
+    void applyTheme(QTextDocument *document) const;
+
+    /**
+     * @brief Re-fits a formatted document to a new viewport width in place.
+     *
+     * Side margins are a fixed fraction (BORDER_MARGIN) of the viewport width;
+     * this recomputes them for @p viewportWidth and sets the document's text
+     * width. Text and character formats are kept, so only the layout is redone.
+     */
+    void applyViewportWidth(QTextDocument *document, int viewportWidth);
+
+    /**
+     * @brief Sets the interning table used to resolve precomputed user colors.
+     * @param users The directory owned by the MessageStorage backend, or nullptr.
      */
-    void appendMessage(QTextEdit *textEdit,
-                       const QString &user,
-                       const QString &message,
-                       const QDateTime &timestamp,
-                       bool isSent);
+    void setUserDirectory(const UserDirectory *users) { m_users = users; }
     ///@}
 
 private:
@@ -86,31 +187,58 @@ private:
     QTextCursor lastTimestampCursor;  ///< Cursor for delayed timestamp insertion.
     QDateTime lastTimestamp;          ///< Timestamp of the last message.
     bool hasPendingTimestamp = false; ///< Indicates if a timestamp is pending.
-    QMap<QString, QColor> userColorMap; ///< Caches user-specific colors.
+    QMap<QString, QColor> userColorMap; ///< Caches colors of users not in the directory.
+    const UserDirectory *m_users = nullptr; ///< Interned users with precomputed colors.
+    bool m_isDark = false;                  ///< Active theme variant.
+    quint64 m_themeSerial = 0;              ///< Bumped by setDarkTheme() on a change.
     ///@}
 
-    ///@name Message Formatting Helpers
+    ///@name Cached Formats
     ///@{
+    QTextCharFormat m_bodyFormat;           ///< Body format; the color comes from the palette.
+    QTextCharFormat m_timestampFormat;      ///< Timestamp role format for the active theme.
+    QHash<QRgb, QTextCharFormat> m_senderFormats; ///< Sender formats by user color.
+    QTextBlockFormat m_sentBlockFormat;     ///< Block format of sent messages at m_blockFormatWidth.
+    QTextBlockFormat m_receivedBlockFormat; ///< Block format of received messages at m_blockFormatWidth.
+    int m_blockFormatWidth = -1;            ///< Viewport width the block formats were built for.
+    ///@}
+
     /**
- * @brief Inserts a paragraph block into the chat with appropriate alignment and margin.
- *
- * @param textEdit The QTextEdit used to calculate dynamic margin width.
- * @param cursor The text cursor at which to insert the block.
- * @param isSent True if the message was sent by the local user; affects alignment.
- */
-    void insertBlock(QTextEdit *textEdit, QTextCursor &cursor, bool isSent);
+     * @brief Rebuilds the cached character formats for the active theme.
+     */
+    void rebuildCharFormats();
+
+    /**
+     * @brief Rebuilds the cached block formats if @p viewportWidth changed.
+     */
+    void updateBlockFormats(int viewportWidth);
 
     /**
+     * @brief Returns the cached sender format for @p color, creating it on first use.
+     */
+    const QTextCharFormat &senderFormat(const QColor &color);
+
+    /**
+     * @brief Returns the theme dependent attributes of @p role for the active theme.
+     *
+     * Only properties that differ between themes are set, so the result can be
+     * merged over an existing fragment.
+     */
+    QTextCharFormat themeFormat(TextRole role) const;
+
+    ///@name Message Formatting Helpers
+    ///@{
+    /**
  * @brief Inserts the sender's name into the chat display with color formatting.
  *
- * Writes the user’s name into the QTextEdit, using a bold and color-styled font.
+ * Writes the user’s name using a bold and color-styled font.
  * Only shown when the sender changes or for the first message in a series.
  *
  * @param cursor The text cursor to insert at.
  * @param user The name of the user to display.
- * @param color The QColor to use for the user label.
+ * @param format The sender format, carrying the user's color.
  */
-    void insertUserLine(QTextCursor &cursor, const QString &user, const QColor &color);
+    static void insertUserLine(QTextCursor &cursor, const QString &user, const QTextCharFormat &format);
 
     /**
  * @brief Inserts the main chat message content.
@@ -120,38 +248,26 @@ private:
  *
  * @param cursor The text cursor to insert at.
  * @param message The actual message text.
+ * @param format The body format.
  */
-    void insertMessageLine(QTextCursor &cursor, const QString &message);
+    static void insertMessageLine(QTextCursor &cursor, const QString &message, const QTextCharFormat &format);
 
     /**
  * @brief Inserts a timestamp line below the chat message.
  *
  * Renders a timestamp beneath the chat message in a lighter style and smaller font.
  * Intended to visually separate message clusters and provide time context.
+ * The font family follows the document's default font; the color follows the theme.
  *
  * @param cursor The text cursor to insert at.
  * @param ts The UTC timestamp of the message.
- * @param baseFont The base font to derive size and style from.
- * @param isDark Whether the current theme is dark (affects timestamp color).
+ * @param format The timestamp format.
  */
-    void insertTimestampLine(QTextCursor &cursor, const QDateTime &ts, const QFont &baseFont, const bool &isDark);
+    static void insertTimestampLine(QTextCursor &cursor, const QDateTime &ts, const QTextCharFormat &format);
     ///@}
 
     ///@name Color Handling
     ///@{
-    /**
- * @brief Resolves the display color for a user, considering message direction.
- *
- * If the user has a cached color in the internal map, it is returned directly.
- * Otherwise, a new color is generated using the user's name. Messages sent by
- * the local user may use a distinct default color.
- *
- * @param user The name of the user whose color is to be resolved.
- * @param isSent True if the message was sent by the local user; affects fallback color.
- * @return The resolved or generated color for the user.
- */
-    QColor resolveUserColor(const QString &user, bool isSent);
-
     /**
  * @brief Generates a deterministic color for a given username.
  *
@@ -166,9 +282,9 @@ private:
     /**
  * @brief Retrieves or generates and caches a color for the given user.
  *
- * Ensures consistent color use throughout the chat. If the user already has a
- * cached color in the `userColorMap`, that color is returned. Otherwise, a new
- * color is generated using `generateColorForUser()` and stored for reuse.
+ * Ensures consistent color use throughout the chat. Users interned in the
+ * UserDirectory return their precomputed color. Otherwise the `userColorMap`
+ * cache is consulted and filled using `generateColorForUser()`.
  *
  * @param user The username or identifier.
  * @return A cached or newly generated QColor.
@@ -179,22 +295,20 @@ private:
     ///@name Layout Utility
     ///@{
     /**
- * @brief Calculates a horizontal margin relative to the QTextEdit width.
+ * @brief Calculates a horizontal margin relative to the viewport width.
  *
- * Determines a pixel-based margin based on a percentage of the width of the
- * parent QTextEdit associated with the given cursor. If the parent cannot
- * be determined (e.g., null cursor or missing widget), a fallback value is returned.
+ * Determines a pixel-based margin based on a percentage of the chat viewport's
+ * width. If no valid width is known yet, a fallback value is returned.
  *
  * Commonly used to align message blocks with appropriate indentation depending on layout width.
  *
- * @param cursor The QTextCursor from which the parent QTextEdit is inferred.
- * @param percent A fractional value (e.g., 0.15 for 15%) of the QTextEdit's width.
+ * @param viewportWidth Width of the chat viewport in pixels.
+ * @param percent A fractional value (e.g., 0.15 for 15%) of the viewport's width.
  * @param fallback The pixel value to return if no valid width can be determined.
  * @return The calculated margin in pixels, or the fallback if width could not be computed.
  */
-    int calculateDynamicMargin(QTextEdit *textEdit, double percent, int fallback) const;
+    int calculateDynamicMargin(int viewportWidth, double percent, int fallback) const;
     ///@}
-    void insertLastReadMarker(QTextEdit *textEdit);
 };
 
 #endif // CHATFORMATTER_H
@@ -0,0 +1,265 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "chatmessagedelegate.h"
+#include "../ChatFormatter/chatformatter.h"
+#include "../ChatMessageModel/chatmessagemodel.h"
+
+#include <QAbstractTextDocumentLayout>
+#include <QPainter>
+#include <QThread>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QtMath>
+
+#include "../Utils/debugmacros.h"
+
+ChatMessageDelegate::ChatMessageDelegate(ChatFormatter *formatter, QObject *parent)
+    : QStyledItemDelegate(parent)
+    , m_formatter(formatter)
+    , m_documents(kMaxCachedDocuments)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    m_layoutPool.setMaxThreadCount(kLayoutThreads);
+} //ChatMessageDelegate
+
+void ChatMessageDelegate::invalidate()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    ++m_layoutGeneration;
+    m_pendingLayouts.clear();
+    m_documents.clear();
+} //invalidate
+
+void ChatMessageDelegate::setDarkTheme(bool isDark)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    if (isDark == m_formatter->isDarkTheme())
+        return;
+
+    m_formatter->setDarkTheme(isDark);
+
+    // Cached documents take the new formats in place; nothing is re-read or re-formatted.
+    // Layouts still on the pool carry the old serial and are dropped when they finish.
+    const quint64 themeSerial = m_formatter->themeSerial();
+    const QList<qint64> ids = m_documents.keys();
+    for (const qint64 id : ids) {
+        Entry *entry = m_documents.object(id);
+        m_formatter->applyTheme(entry->document.get());
+        entry->themeSerial = themeSerial;
+    }
+} //setDarkTheme
+
+void ChatMessageDelegate::setDocumentLimit(int documentCount)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    m_documents.setMaxCost(qMax(1, documentCount));
+} //setDocumentLimit
+
+ChatMessageDelegate::Entry *ChatMessageDelegate::entryFor(const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    const auto *model = qobject_cast<const ChatMessageModel *>(index.model());
+    if (!model)
+        return nullptr;
+
+    MessageBatchPtr batch;
+    int position = 0;
+    if (model->messageAt(index.row(), batch, position) != ChatMessageModel::RowState::Present)
+        return nullptr;
+
+    const qint64 id = model->idForRow(index.row());
+    const int width = option.rect.width();
+    const bool showsSender = model->showsSender(index.row());
+
+    // Remembered for prelayoutRows().
+    m_layoutFont = option.font;
+    m_layoutWidth = width;
+
+    Entry *entry = m_documents.object(id);
+    if (entry && entry->showsSender == showsSender) {
+        // Off-screen rows catch up with a resize here, when they are next needed.
+        if (entry->width != width) {
+            m_formatter->applyViewportWidth(entry->document.get(), width);
+            entry->width = width;
+        }
+
+        if (entry->document->defaultFont() != option.font)
+            entry->document->setDefaultFont(option.font);
+        return entry;
+    }
+
+    entry = new Entry;
+    entry->document = std::make_shared<QTextDocument>();
+    entry->width = width;
+    entry->showsSender = showsSender;
+    entry->themeSerial = m_formatter->themeSerial();
+    entry->document->setUndoRedoEnabled(false);
+    entry->document->setDefaultFont(option.font);
+    entry->document->setTextWidth(width);
+    m_formatter->formatMessage(entry->document.get(), *batch, position, showsSender, width);
+
+    m_documents.insert(id, entry);
+    return entry;
+} //entryFor
+
+void ChatMessageDelegate::prelayoutRows(const ChatMessageModel *model, int firstVisibleRow, int lastVisibleRow)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    if (!model || m_layoutWidth <= 0 || firstVisibleRow < 0)
+        return;
+
+    const int width = m_layoutWidth;
+    const QFont font = m_layoutFont;
+    const quint64 themeSerial = m_formatter->themeSerial();
+    const quint64 generation = m_layoutGeneration;
+
+    const int firstRow = qMax(0, firstVisibleRow - kPrelayoutRows);
+    const int lastRow = qMin(model->rowCount() - 1, lastVisibleRow + kPrelayoutRows);
+
+    for (int row = firstRow; row <= lastRow; ++row) {
+        if (row >= firstVisibleRow && row <= lastVisibleRow)
+            continue; // painted on the GUI thread
+
+        const qint64 id = model->idForRow(row);
+        if (m_pendingLayouts.contains(id) || !model->isResident(row))
+            continue; // never read pages from here
+
+        const bool showsSender = model->showsSender(row);
+        const Entry *cached = m_documents.object(id);
+        if (cached && cached->width == width && cached->showsSender == showsSender
+            && cached->themeSerial == themeSerial && cached->document->defaultFont() == font)
+            continue;
+
+        MessageBatchPtr batch;
+        int position = 0;
+        if (model->messageAt(row, batch, position) != ChatMessageModel::RowState::Present)
+            continue;
+
+        const ChatFormatter::PreparedMessage message = m_formatter->prepareMessage(*batch, position, showsSender, width);
+        QThread *guiThread = thread();
+
+        m_pendingLayouts.insert(id);
+
+        QtConcurrent::run(&m_layoutPool, [message, font, width, guiThread]() {
+            auto document = std::make_shared<QTextDocument>();
+            document->setUndoRedoEnabled(false);
+            document->setDefaultFont(font);
+            document->setTextWidth(width);
+            ChatFormatter::writePreparedMessage(document.get(), message);
+
+            // Shaping and line breaking happen here rather than in the first paint.
+            document->documentLayout()->documentSize();
+
+            document->moveToThread(guiThread);
+            return document;
+        }).then(this, [this, id, width, font, showsSender, themeSerial, generation](const std::shared_ptr<QTextDocument> &document) {
+            if (generation != m_layoutGeneration)
+                return; // invalidated meanwhile
+
+            m_pendingLayouts.remove(id);
+
+            // A resize, font or theme change made the layout stale; rows on screen were laid out directly.
+            if (width != m_layoutWidth || font != m_layoutFont || themeSerial != m_formatter->themeSerial())
+                return;
+
+            const Entry *cached = m_documents.object(id);
+            if (cached && cached->width == width && cached->showsSender == showsSender)
+                return; // built on the GUI thread meanwhile
+
+            auto *entry = new Entry;
+            entry->document = document;
+            entry->width = width;
+            entry->showsSender = showsSender;
+            entry->themeSerial = themeSerial;
+            m_documents.insert(id, entry);
+        });
+    }
+} //prelayoutRows
+
+QSize ChatMessageDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    const auto state = ChatMessageModel::RowState(index.data(ChatMessageModel::RowStateRole).toInt());
+    if (state == ChatMessageModel::RowState::Missing)
+        return QSize(0, 0);
+
+    const int marker = markerHeight(option, index);
+
+    const Entry *entry = entryFor(option, index);
+    if (!entry) {
+        // Roughly one sender line and one message line until the page arrives.
+        return QSize(option.rect.width(), marker + 2 * option.fontMetrics.height() + 8);
+    }
+
+    return QSize(option.rect.width(), marker + qCeil(entry->document->size().height()));
+} //sizeHint
+
+QFont ChatMessageDelegate::markerFont(const QStyleOptionViewItem &option)
+{
+    QFont font = option.font;
+    font.setItalic(true);
+    font.setPointSize(10);
+    return font;
+} //markerFont
+
+int ChatMessageDelegate::markerHeight(const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    if (!index.data(ChatMessageModel::LastReadMarkerRole).toBool())
+        return 0;
+
+    return QFontMetrics(markerFont(option)).height() + 2 * kMarkerPadding;
+} //markerHeight
+
+void ChatMessageDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    const int marker = markerHeight(option, index);
+    if (marker > 0) {
+        painter->save();
+        painter->setFont(markerFont(option));
+        painter->setPen(Qt::red);
+        painter->drawText(QRect(option.rect.left(), option.rect.top(), option.rect.width(), marker),
+                          Qt::AlignCenter,
+                          tr("──────────── Last Read ────────────"));
+        painter->restore();
+    }
+
+    Entry *entry = entryFor(option, index);
+    if (!entry)
+        return;
+
+    painter->save();
+    painter->translate(option.rect.topLeft() + QPoint(0, marker));
+
+    QAbstractTextDocumentLayout::PaintContext context;
+    context.palette = option.palette;
+    context.clip = QRectF(0, 0, option.rect.width(), option.rect.height() - marker);
+
+    painter->setClipRect(context.clip);
+    entry->document->documentLayout()->draw(painter, context);
+
+    painter->restore();
+} //paint
@@ -0,0 +1,152 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHATMESSAGEDELEGATE_H
+#define CHATMESSAGEDELEGATE_H
+
+#include <QCache>
+#include <QSet>
+#include <QStyledItemDelegate>
+#include <QTextDocument>
+#include <QThreadPool>
+
+#include <memory>
+
+class ChatFormatter;
+class ChatMessageModel;
+class MessageBatch;
+
+/**
+ * @class ChatMessageDelegate
+ * @brief Paints ChatMessageModel rows as formatted chat messages.
+ *
+ * Each message is formatted by ChatFormatter into its own QTextDocument. Only
+ * documents of recently painted rows are kept, in a cache keyed by message id,
+ * so the cost of a frame depends on the rows on screen rather than on the
+ * length of the history. Rows whose page is still loading are given a
+ * placeholder height and left blank until the model reports them.
+ *
+ * A theme or width change does not rebuild documents. setDarkTheme() updates
+ * the theme formats of every cached document in place when the view's palette
+ * changes. A cached document picks up the view's new font and margins
+ * recomputed for the new width the next time it is measured or painted. After
+ * a resize only the rows on screen are re-laid out right away.
+ *
+ * The last read marker is painted above the row the model flags with
+ * ChatMessageModel::LastReadMarkerRole, outside the cached document, so moving
+ * it re-measures two rows and formats nothing.
+ *
+ * Rows just off screen are formatted and laid out ahead of time on a small
+ * thread pool (see prelayoutRows()), so scrolling into them or finishing a
+ * resize only paints. Rows on screen are never left waiting: if their document
+ * is missing or stale, it is built on the GUI thread as before.
+ */
+class ChatMessageDelegate : public QStyledItemDelegate {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Constructs the delegate.
+     * @param formatter Formatter writing messages into documents.
+     * @param parent Optional QObject parent.
+     */
+    explicit ChatMessageDelegate(ChatFormatter *formatter, QObject *parent = nullptr);
+
+    void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+    /**
+     * @brief Drops every cached document.
+     *
+     * Called when the user directory or the history itself changed.
+     */
+    void invalidate();
+
+    /**
+     * @brief Switches the formatter to the light or dark theme and re-themes cached documents.
+     *
+     * Called when the view's palette changed; a no-op if the variant is unchanged.
+     */
+    void setDarkTheme(bool isDark);
+
+    /**
+     * @brief Bounds the number of formatted documents kept, evicting beyond it.
+     */
+    void setDocumentLimit(int documentCount);
+
+    /**
+     * @brief Lays out the rows around the ones on screen on the layout pool.
+     *
+     * Covers up to kPrelayoutRows rows above @p firstVisibleRow and below
+     * @p lastVisibleRow at the width, font and theme of the last paint. Rows
+     * already cached for those, rows being laid out and rows whose page is
+     * not resident are skipped. Finished documents enter the cache on the GUI
+     * thread unless the width, font or theme changed meanwhile.
+     *
+     * @param model The model the rows belong to.
+     * @param firstVisibleRow First row on screen.
+     * @param lastVisibleRow Last row on screen.
+     */
+    void prelayoutRows(const ChatMessageModel *model, int firstVisibleRow, int lastVisibleRow);
+
+    /// Rows laid out ahead on each side of the screen.
+    static constexpr int kPrelayoutRows = 24;
+
+    /// Default bound on formatted documents kept in memory.
+    static constexpr int kMaxCachedDocuments = 512;
+
+private:
+    /**
+     * @brief A formatted message and the inputs it was formatted with.
+     */
+    struct Entry {
+        std::shared_ptr<QTextDocument> document; ///< The formatted message.
+        int width = 0;            ///< Viewport width the margins were computed for.
+        bool showsSender = true;  ///< Whether the sender line was written.
+        quint64 themeSerial = 0;  ///< ChatFormatter::themeSerial() the formats match.
+    };
+
+    /// Returns the font of the last read marker.
+    static QFont markerFont(const QStyleOptionViewItem &option);
+
+    /// Returns the height of the last read marker above @p index, or 0 if it has none.
+    int markerHeight(const QStyleOptionViewItem &option, const QModelIndex &index) const;
+
+    /**
+     * @brief Returns the entry of the row at @p index, formatting it if needed.
+     * @return The entry, or nullptr if the row has no resident message.
+     */
+    Entry *entryFor(const QStyleOptionViewItem &option, const QModelIndex &index) const;
+
+    /// Space above and below the last read marker's text.
+    static constexpr int kMarkerPadding = 4;
+
+    /// Worker threads of the layout pool; the GUI thread keeps the rows on screen.
+    static constexpr int kLayoutThreads = 2;
+
+    ChatFormatter *m_formatter;                  /**< Writes messages into documents. */
+    mutable QCache<qint64, Entry> m_documents;   /**< Formatted documents by message id. */
+
+    mutable QFont m_layoutFont;                  /**< Font of the last measured or painted row. */
+    mutable int m_layoutWidth = 0;               /**< Width of the last measured or painted row. */
+    quint64 m_layoutGeneration = 0;              /**< Bumped by invalidate(); older layouts are dropped. */
+    QSet<qint64> m_pendingLayouts;               /**< Message ids on the layout pool. */
+    QThreadPool m_layoutPool;                    /**< Formats and lays out rows off screen. */
+};
+
+#endif // CHATMESSAGEDELEGATE_H
@@ -0,0 +1,179 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "chatmessagemodel.h"
+#include "../ChatPager/chatpager.h"
+
+#include "../Utils/debugmacros.h"
+
+ChatMessageModel::ChatMessageModel(ChatPager *pager, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_pager(pager)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    connect(m_pager, &ChatPager::historyReset, this, &ChatMessageModel::onHistoryReset);
+    connect(m_pager, &ChatPager::messagesAppended, this, &ChatMessageModel::onMessagesAppended);
+    connect(m_pager, &ChatPager::pageLoaded, this, &ChatMessageModel::onPageLoaded);
+
+    onHistoryReset();
+} //ChatMessageModel
+
+int ChatMessageModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_rowCount;
+} //rowCount
+
+qint64 ChatMessageModel::idForRow(int row) const
+{
+    return m_firstId + row;
+} //idForRow
+
+int ChatMessageModel::rowForId(qint64 id) const
+{
+    if (m_rowCount == 0 || id < m_firstId || id >= m_firstId + m_rowCount)
+        return -1;
+    return int(id - m_firstId);
+} //rowForId
+
+ChatMessageModel::RowState ChatMessageModel::messageAt(int row, MessageBatchPtr &batch, int &position) const
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    const qint64 id = idForRow(row);
+    qint64 loadedUpTo = 0;
+
+    batch = m_pager->page(m_pager->pageOf(id), &loadedUpTo);
+    if (!batch || id > loadedUpTo)
+        return RowState::Pending;
+
+    position = batch->indexOf(id);
+    return position < 0 ? RowState::Missing : RowState::Present;
+} //messageAt
+
+void ChatMessageModel::setLastReadMarker(qint64 id)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    if (id == m_lastReadMarker)
+        return;
+
+    const int oldRow = m_lastReadMarker > 0 ? rowForId(m_lastReadMarker + 1) : -1;
+    m_lastReadMarker = id;
+    const int newRow = id > 0 ? rowForId(id + 1) : -1;
+
+    if (oldRow >= 0)
+        emit dataChanged(index(oldRow), index(oldRow), {LastReadMarkerRole});
+    if (newRow >= 0)
+        emit dataChanged(index(newRow), index(newRow), {LastReadMarkerRole});
+} //setLastReadMarker
+
+bool ChatMessageModel::isResident(int row) const
+{
+    if (!m_pager->isResident(m_pager->pageOf(idForRow(row))))
+        return false;
+    return row == 0 || m_pager->isResident(m_pager->pageOf(idForRow(row - 1)));
+} //isResident
+
+bool ChatMessageModel::showsSender(int row) const
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    MessageBatchPtr batch;
+    int position = 0;
+    if (row <= 0 || messageAt(row, batch, position) != RowState::Present)
+        return true;
+
+    const int userId = batch->userId(position);
+    const bool isSent = batch->isSentByMe(position);
+
+    if (messageAt(row - 1, batch, position) != RowState::Present)
+        return true;
+
+    return batch->userId(position) != userId || batch->isSentByMe(position) != isSent;
+} //showsSender
+
+QVariant ChatMessageModel::data(const QModelIndex &index, int role) const
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    if (!index.isValid() || index.row() >= m_rowCount)
+        return QVariant();
+
+    MessageBatchPtr batch;
+    int position = 0;
+    const RowState state = messageAt(index.row(), batch, position);
+
+    if (role == RowStateRole)
+        return QVariant::fromValue(int(state));
+    if (role == MessageIdRole)
+        return idForRow(index.row());
+    if (role == LastReadMarkerRole)
+        return m_lastReadMarker > 0 && idForRow(index.row()) == m_lastReadMarker + 1;
+    if (state != RowState::Present)
+        return QVariant();
+
+    switch (role) {
+    case Qt::DisplayRole:
+        return batch->text(position).toString();
+    case UserIdRole:
+        return batch->userId(position);
+    case TimestampRole:
+        return batch->timestamp(position);
+    case SentByMeRole:
+        return batch->isSentByMe(position);
+    case ShowSenderRole:
+        return showsSender(index.row());
+    default:
+        return QVariant();
+    }
+} //data
+
+void ChatMessageModel::onHistoryReset()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    beginResetModel();
+    m_firstId = m_pager->firstId();
+    m_rowCount = m_pager->lastId() > 0 ? int(m_pager->lastId() - m_firstId + 1) : 0;
+    endResetModel();
+} //onHistoryReset
+
+void ChatMessageModel::onMessagesAppended(qint64 firstNewId, qint64 lastNewId)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    const int firstRow = int(firstNewId - m_firstId);
+    const int lastRow = int(lastNewId - m_firstId);
+
+    beginInsertRows(QModelIndex(), firstRow, lastRow);
+    m_rowCount = lastRow + 1;
+    endInsertRows();
+} //onMessagesAppended
+
+void ChatMessageModel::onPageLoaded(qint64 firstId, qint64 lastId)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    const int first = int(qMax<qint64>(0, firstId - m_firstId));
+    // The row after the range may now know its previous sender.
+    const int last = int(qMin<qint64>(m_rowCount - 1, lastId + 1 - m_firstId));
+
+    if (first <= last)
+        emit dataChanged(index(first), index(last));
+} //onPageLoaded
@@ -0,0 +1,122 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHATMESSAGEMODEL_H
+#define CHATMESSAGEMODEL_H
+
+#include "../MessageBatch/messagebatch.h"
+
+#include <QAbstractListModel>
+
+class ChatPager;
+
+/**
+ * @class ChatMessageModel
+ * @brief List model exposing the whole chat history, one row per message id.
+ *
+ * Row r is message id firstId + r, so the model spans the complete history
+ * without holding it: rows are resolved on demand through ChatPager, which
+ * keeps only a bounded set of pages in memory. A row whose page is still being
+ * read reports RowState::Pending; dataChanged() follows once it arrives.
+ *
+ * Views that paint many rows per frame can use messageAt() to reach the
+ * MessageBatch directly instead of going through QVariant roles.
+ */
+class ChatMessageModel : public QAbstractListModel {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Custom data roles. Qt::DisplayRole returns the message text.
+     */
+    enum Role {
+        MessageIdRole = Qt::UserRole + 1, ///< qint64 message id.
+        UserIdRole,                       ///< Interned sender id.
+        TimestampRole,                    ///< QDateTime in UTC.
+        SentByMeRole,                     ///< True if sent by the local user.
+        ShowSenderRole,                   ///< True if the sender differs from the previous row.
+        RowStateRole,                     ///< RowState of the row.
+        LastReadMarkerRole                ///< True if the last read marker sits above the row.
+    };
+
+    /**
+     * @brief Availability of a row's message.
+     */
+    enum class RowState {
+        Pending, ///< The page holding the row is being read.
+        Present, ///< The message is resident.
+        Missing  ///< The id holds no message.
+    };
+
+    /**
+     * @brief Constructs the model over @p pager's history.
+     */
+    explicit ChatMessageModel(ChatPager *pager, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    /// Returns the message id shown in @p row.
+    qint64 idForRow(int row) const;
+
+    /// Returns the row showing message @p id, or -1 if it is outside the history.
+    int rowForId(qint64 id) const;
+
+    /**
+     * @brief Resolves the message of @p row.
+     * @param row The row to look up.
+     * @param batch Receives the resident page holding the message.
+     * @param position Receives the index of the message in @p batch.
+     * @return Present if @p batch and @p position are valid.
+     */
+    RowState messageAt(int row, MessageBatchPtr &batch, int &position) const;
+
+    /**
+     * @brief Places the last read marker after message @p id.
+     *
+     * The marker is shown above the row of the next id; 0 hides it. Only the
+     * rows the marker leaves and enters are reported changed.
+     */
+    void setLastReadMarker(qint64 id);
+
+    /// Returns the id the last read marker follows, or 0 if it is hidden.
+    qint64 lastReadMarker() const { return m_lastReadMarker; }
+
+    /**
+     * @brief Returns true if @p row and the row before it can be resolved without a read.
+     */
+    bool isResident(int row) const;
+
+    /**
+     * @brief Returns true if @p row starts a new sender group.
+     */
+    bool showsSender(int row) const;
+
+private slots:
+    void onHistoryReset();
+    void onMessagesAppended(qint64 firstNewId, qint64 lastNewId);
+    void onPageLoaded(qint64 firstId, qint64 lastId);
+
+private:
+    ChatPager *m_pager;      /**< Source of resident pages. */
+    qint64 m_firstId = 0;    /**< Id shown in row 0. */
+    int m_rowCount = 0;      /**< Number of ids spanned by the history. */
+    qint64 m_lastReadMarker = 0; /**< Id the last read marker follows. */
+};
+
+#endif // CHATMESSAGEMODEL_H
@@ -1,78 +1,270 @@
 #include "chatpager.h"
-#include "cmath"
 
-ChatPager::ChatPager(MessageStore *store, ChatFormatter *formatter, QObject *parent)
+#include <algorithm>
+
+ChatPager::ChatPager(MessageStorage *store, QObject *parent)
     : QObject(parent)
     , m_store(store)
-    , m_formatter(formatter)
 {}
 
-void ChatPager::loadPage(int offset)
+void ChatPager::setStore(MessageStorage *store)
 {
-    if (m_isLoading || offset == m_currentOffset)
-        return;
+    m_store = store;
+    reload();
+} //setStore
 
-    m_isLoading = true;
+void ChatPager::reload()
+{
+    ++m_generation;
 
-    int total = m_store->messageCount();
+    for (const ResidentPage &resident : std::as_const(m_pages)) {
+        if (resident.isUnusedPrefetch)
+            ++m_prefetchStats.wasted;
+    }
 
-    if (total == 0) {
-        m_isLoading = false;
-        return;
+    m_pages.clear();
+    m_pending.clear();
+    m_backfills.clear();
+    m_lastNotedFirstId = -1;
+    m_idsPerSecond = 0.0;
+
+    m_firstId = m_store->firstMessageId();
+    m_lastId = m_store->lastMessageId();
+
+    emit historyReset();
+} //reload
+
+void ChatPager::refreshTail()
+{
+    // The shared layout may link a new message to an older row, below ids already read.
+    const qint64 backfilledId = m_store->takeBackfilledId();
+    if (backfilledId > 0 && m_lastId > 0) {
+        if (backfilledId < m_firstId) {
+            reload(); // older than row 0; the rows shift
+            return;
+        }
+        if (backfilledId <= m_lastId)
+            refreshPagesFrom(backfilledId);
     }
 
-    int clamped = clampOffset(offset, total);
-    if (clamped == m_currentOffset) {
-        m_isLoading = false;
+    const qint64 lastId = m_store->lastMessageId();
+    if (lastId <= m_lastId)
+        return;
+
+    if (m_lastId == 0) {
+        reload(); // the first message also fixes firstId
         return;
     }
 
-    QList<Message> messages = m_store->fetchMessages(clamped, m_messagesPerPage);
-    m_currentOffset = clamped;
-    m_visibleOffset = clamped;
-    m_visibleLimit = messages.count();
+    const qint64 firstNewId = m_lastId + 1;
+    m_lastId = lastId;
+
+    // The old tail page is re-read on its next lookup; until then it keeps serving.
+    emit messagesAppended(firstNewId, lastId);
+} //refreshTail
+
+MessageBatchPtr ChatPager::page(qint64 pageNumber, qint64 *loadedUpTo)
+{
+    auto it = m_pages.find(pageNumber);
+    if (it == m_pages.end()) {
+        requestPage(pageNumber);
+
+        // Backends without a read pool answer synchronously.
+        it = m_pages.find(pageNumber);
+        if (it == m_pages.end())
+            return nullptr;
+    }
+
+    it->lastUse = ++m_useClock;
 
-    m_totalPages = std::ceil((double) total / (double) m_messagesPerPage);
-    m_currentPage = std::ceil(((double) m_currentOffset / (double) m_messagesPerPage)) + 1;
+    if (it->isUnusedPrefetch) {
+        it->isUnusedPrefetch = false;
+        ++m_prefetchStats.hits;
+    }
+
+    // Copy out first: a synchronous re-read below may rehash m_pages.
+    const MessageBatchPtr batch = it->batch;
+    const qint64 pageLoadedUpTo = it->loadedUpTo;
+
+    const qint64 pageEnd = (pageNumber + 1) * m_messagesPerPage - 1;
+    if (pageLoadedUpTo < qMin(pageEnd, m_lastId) || m_backfills.contains(pageNumber))
+        requestPage(pageNumber);
 
-    emit messagesReady(messages);
-    m_isLoading = false;
-} //loadPage
+    if (loadedUpTo)
+        *loadedUpTo = pageLoadedUpTo;
+    return batch;
+} //page
 
-void ChatPager::handleScroll(QScrollBar *scrollBar, bool scrollingDown)
+void ChatPager::requestPage(qint64 pageNumber, bool isPrefetch)
 {
-    if (m_isLoading)
+    if (m_requestsHeld || m_pending.contains(pageNumber))
         return;
 
-    int sb_currValue = scrollBar->value();
-    int sb_min = scrollBar->minimum();
-    int sb_max = scrollBar->maximum();
-    int msgCount = m_store->messageCount();
-    bool scrollingUp = !scrollingDown;
+    if (isPrefetch)
+        ++m_prefetchStats.requested;
 
-    if (scrollingDown && sb_currValue == sb_max && (m_currentOffset + m_messagesPerPage) < msgCount) {
-        loadPage(m_currentOffset + m_messagesPerPage);
-        if (m_currentPage < m_totalPages){
-            emit scrollToTopAdjustmentRequested();
-        }
-        else {
-            emit scrollToValueAdjustmentRequested(sb_max);
-        }
+    const qint64 first = pageNumber * m_messagesPerPage;
+    const qint64 tailAtRequest = m_lastId;
+    const quint64 generation = m_generation;
+    const quint64 backfillSerial = m_backfillSerial;
+
+    m_pending.insert(pageNumber);
+
+    m_store->fetchMessageRangeAsync(first, first + m_messagesPerPage - 1)
+        .then(this, [this, pageNumber, tailAtRequest, generation, backfillSerial, isPrefetch](const MessageBatchPtr &batch) {
+            if (generation != m_generation)
+                return; // reloaded meanwhile
+
+            m_pending.remove(pageNumber);
+
+            const qint64 first = pageNumber * m_messagesPerPage;
+            const qint64 last = qMin(first + m_messagesPerPage - 1, tailAtRequest);
+
+            ResidentPage &resident = m_pages[pageNumber];
+            // Stored messages never change, so a re-read only adds ids past the old tail,
+            // or ids a backfill linked below it.
+            qint64 firstNew = resident.batch ? qMax(first, resident.loadedUpTo + 1) : first;
+
+            bool isBackfillMissed = false;
+            const auto backfill = m_backfills.constFind(pageNumber);
+            if (backfill != m_backfills.cend()) {
+                if (backfill->serial <= backfillSerial) {
+                    firstNew = qMin(firstNew, backfill->firstId);
+                    m_backfills.erase(backfill);
+                } else {
+                    isBackfillMissed = true; // the read started before the link
+                }
+            }
+
+            if (!resident.batch)
+                resident.isUnusedPrefetch = isPrefetch;
+
+            resident.batch = batch;
+            resident.loadedUpTo = tailAtRequest;
+            resident.lastUse = ++m_useClock;
+
+            evictPages();
+
+            if (firstNew <= last)
+                emit pageLoaded(firstNew, last);
+
+            if (isBackfillMissed)
+                requestPage(pageNumber);
+        });
+} //requestPage
+
+void ChatPager::setResidentMessageLimit(int messageCount)
+{
+    m_maxResidentPages = qMax(kMinResidentPages, messageCount / m_messagesPerPage);
+    evictPages();
+} //setResidentMessageLimit
+
+void ChatPager::evictPages()
+{
+    if (m_pages.size() <= m_maxResidentPages)
+        return;
+
+    QList<QPair<quint64, qint64>> byAge; // (lastUse, page number)
+    byAge.reserve(m_pages.size());
+    for (auto it = m_pages.cbegin(); it != m_pages.cend(); ++it)
+        byAge.append({it->lastUse, it.key()});
+
+    const int keep = m_maxResidentPages - m_maxResidentPages / 4;
+    const int trim = int(byAge.size()) - keep;
+    std::nth_element(byAge.begin(), byAge.begin() + trim, byAge.end());
+
+    for (int i = 0; i < trim; ++i) {
+        const auto it = m_pages.find(byAge.at(i).second);
+        if (it->isUnusedPrefetch)
+            ++m_prefetchStats.wasted;
+        m_pages.erase(it);
     }
+} //evictPages
 
-    else if (scrollingUp && sb_currValue == sb_min && m_currentOffset > 0) {
-        loadPage(m_currentOffset - m_messagesPerPage);
-        if (m_currentPage > 1){
-            emit scrollToBottomAdjustmentRequested();
-        }
-        else {
-            emit scrollToValueAdjustmentRequested(sb_min);
-        }
+void ChatPager::refreshPagesFrom(qint64 firstId)
+{
+    const qint64 firstPage = pageOf(firstId);
+    const quint64 serial = ++m_backfillSerial;
+
+    QList<qint64> pages;
+    for (auto it = m_pages.cbegin(); it != m_pages.cend(); ++it) {
+        if (it.key() >= firstPage)
+            pages.append(it.key());
+    }
+    for (const qint64 pageNumber : std::as_const(m_pending)) {
+        if (pageNumber >= firstPage && !m_pages.contains(pageNumber))
+            pages.append(pageNumber);
+    }
+
+    for (const qint64 pageNumber : std::as_const(pages)) {
+        Backfill &backfill = m_backfills[pageNumber];
+        const qint64 pageFirstId = qMax(firstId, pageNumber * m_messagesPerPage);
+        backfill.firstId = backfill.firstId > 0 ? qMin(backfill.firstId, pageFirstId) : pageFirstId;
+        backfill.serial = serial;
+
+        requestPage(pageNumber); // no-op while a read is in flight; its result is checked
+    }
+} //refreshPagesFrom
+
+void ChatPager::prefetchOlderPages(qint64 beforeId, int pageCount)
+{
+    const qint64 firstPage = pageOf(m_firstId);
+
+    for (qint64 pageNumber = pageOf(beforeId) - 1; pageCount > 0 && pageNumber >= firstPage; --pageNumber, --pageCount) {
+        if (!m_pages.contains(pageNumber))
+            requestPage(pageNumber, true);
     }
-} //handleScroll
+} //prefetchOlderPages
 
-int ChatPager::clampOffset(int requestedOffset, int totalMessages) const
+void ChatPager::setRequestsHeld(bool isHeld)
 {
-    int maxOffset = qMax(0, totalMessages - m_messagesPerPage);
-    return qBound(0, requestedOffset, maxOffset);
-} //clampOffset
+    m_requestsHeld = isHeld;
+
+    if (!isHeld) {
+        m_lastNotedFirstId = -1;
+        m_idsPerSecond = 0.0;
+    }
+} //setRequestsHeld
+
+void ChatPager::noteVisibleRange(qint64 firstId, qint64 lastId)
+{
+    if (!m_scrollClock.isValid())
+        m_scrollClock.start();
+
+    const qint64 elapsedMs = m_scrollClock.restart();
+
+    if (m_lastNotedFirstId >= 0 && elapsedMs > 0) {
+        const double sample = double(firstId - m_lastNotedFirstId) * 1000.0 / double(elapsedMs);
+        m_idsPerSecond = kVelocitySmoothing * sample + (1.0 - kVelocitySmoothing) * m_idsPerSecond;
+    }
+    m_lastNotedFirstId = firstId;
+
+    if (qAbs(m_idsPerSecond) < 1.0 || m_lastId == 0)
+        return;
+
+    const bool isFast = qAbs(m_idsPerSecond) * kLookAheadMs / 1000.0 > m_messagesPerPage;
+    const int pagesAhead = isFast ? 2 : 1;
+    const int step = m_idsPerSecond > 0 ? 1 : -1;
+    const qint64 edgePage = step > 0 ? pageOf(lastId) : pageOf(firstId);
+
+    for (int ahead = 1; ahead <= pagesAhead; ++ahead) {
+        const qint64 pageNumber = edgePage + step * ahead;
+        if (pageNumber < pageOf(m_firstId) || pageNumber > pageOf(m_lastId))
+            break;
+
+        if (!m_pages.contains(pageNumber))
+            requestPage(pageNumber, true);
+    }
+} //noteVisibleRange
+
+void ChatPager::seekToTime(const QDateTime &time)
+{
+    const quint64 serial = ++m_seekSerial;
+
+    m_store->firstMessageIdAtAsync(time).then(this, [this, serial](qint64 messageId) {
+        if (serial != m_seekSerial)
+            return; // superseded
+
+        emit seekResolved(messageId);
+    });
+} //seekToTime
@@ -21,110 +21,256 @@
 #ifndef CHATPAGER_H
 #define CHATPAGER_H
 
-#include <QList>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QObject>
-#include <QScrollBar>
-#include "../ChatFormatter/chatformatter.h"
-#include "../MessageStore/messagestore.h"
+#include <QSet>
 
-#define NUM_MSGS_PER_PAGE 25
+#include "../MessageStorage/messagestorage.h"
+
+#define NUM_MSGS_PER_PAGE 64
 
 /**
  * @class ChatPager
- * @brief Manages paginated loading of chat messages and scroll-driven page transitions.
+ * @brief Pages chat history in and out of memory for the virtualized chat view.
+ *
+ * History is cut into fixed pages of messagesPerPage() consecutive ids: page n
+ * holds ids [n * size, n * size + size - 1], so any row of the view maps to its
+ * page in constant time. Pages are read through the storage's asynchronous API
+ * and only a bounded number stay in memory (see setResidentMessageLimit()).
+ * Past the bound the least recently used quarter is trimmed in one pass, which
+ * keeps memory flat however long the history grows or the window stays open;
+ * trimmed pages are simply read again when the view returns to them.
  *
- * ChatPager fetches batches of messages from a MessageStore, computes page
- * boundaries, emits the loaded messages, and requests scroll adjustments
- * when the user scrolls to the top or bottom of the view.
+ * While the view scrolls, the pager estimates the scroll velocity from the
+ * visible ranges it is told about and reads the next one or two pages in that
+ * direction ahead of time. Reads run on the storage's read pool, so those pages
+ * arrive already decoded and are served from memory when the view reaches them.
+ *
+ * Ids are contiguous in the per-instance SQLite and log backends. Ids that hold
+ * no message (rows never linked to this instance in the shared layout) simply
+ * come back absent from their page.
  */
 class ChatPager : public QObject {
     Q_OBJECT
 
 public:
+    /**
+     * @brief Counters describing how well scroll prefetching predicts the view.
+     */
+    struct PrefetchStats {
+        quint64 requested = 0; ///< Pages read ahead of the view.
+        quint64 hits = 0;      ///< Prefetched pages the view later asked for.
+        quint64 wasted = 0;    ///< Prefetched pages dropped without being asked for.
+    };
+
     /**
      * @brief Constructs a ChatPager.
-     * @param store Pointer to the MessageStore providing access to stored messages.
-     * @param formatter Pointer to a ChatFormatter to format fetched messages.
+     * @param store Pointer to the MessageStorage providing access to stored messages.
      * @param parent Optional QObject parent.
      */
-    ChatPager(MessageStore *store, ChatFormatter *formatter, QObject *parent = nullptr);
+    explicit ChatPager(MessageStorage *store, QObject *parent = nullptr);
 
     /**
-     * @brief Loads a page of messages starting at the given offset.
-     *
-     * If a load is already in progress or the offset equals the current offset,
-     * this call is ignored. Otherwise, it clamps the offset within valid bounds,
-     * fetches up to messagesPerPage() messages, updates internal pagination state,
-     * and emits messagesReady().
+     * @brief Switches to another storage backend and reloads.
+     */
+    void setStore(MessageStorage *store);
+
+    /// Returns the storage pages are read from.
+    MessageStorage *store() const { return m_store; }
+
+    /**
+     * @brief Re-reads the id bounds and drops every resident page.
      *
-     * @param offset Desired zero-based message index to start loading from.
+     * Used after the history was cleared, pruned or imported; historyReset() follows.
      */
-    void loadPage(int offset);
+    void reload();
 
     /**
-     * @brief Handles a scroll event to trigger loading next/previous page.
+     * @brief Picks up messages appended to the store since the last call.
      *
-     * When the user scrolls to the bottom and there are more pages, the next page
-     * is loaded and a scrollToTopAdjustmentRequested() is emitted to reposition view.
-     * Likewise, scrolling to the top loads the previous page and emits
-     * scrollToBottomAdjustmentRequested().
+     * Emits messagesAppended() for the new ids. The page that held the old tail
+     * keeps serving its rows while a fresh copy is read.
      *
-     * @param scrollBar The QScrollBar monitoring the chat view.
-     * @param scrollingDown True if the user is scrolling down; false if up.
+     * Messages the shared layout linked at or below the known tail (see
+     * MessageStorage::takeBackfilledId()) are picked up too: the resident pages
+     * from there on are read again and pageLoaded() reports the ids from the
+     * first backfilled one. A message older than the whole view reloads it.
      */
-    void handleScroll(QScrollBar *scrollBar, bool scrollingDown);
+    void refreshTail();
+
+    /// Returns the id of the oldest message, or 0 if the history is empty.
+    qint64 firstId() const { return m_firstId; }
 
-    /// Returns the current zero-based offset of the loaded page.
-    int currentOffset() const { return m_currentOffset; }
+    /// Returns the id of the newest message, or 0 if the history is empty.
+    qint64 lastId() const { return m_lastId; }
 
-    /// Returns the maximum number of messages per page.
+    /// Returns the number of ids per page.
     int messagesPerPage() const { return m_messagesPerPage; }
 
-    /// Returns the offset of the first visible message in the last loaded page.
-    int visibleOffset() const { return m_visibleOffset; }
+    /// Returns the number of the page holding @p id.
+    qint64 pageOf(qint64 id) const { return id / m_messagesPerPage; }
+
+    /**
+     * @brief Bounds the messages kept in memory, rounded to whole pages.
+     *
+     * At least kMinResidentPages stay resident. Pages beyond the new bound are
+     * trimmed right away.
+     */
+    void setResidentMessageLimit(int messageCount);
 
-    /// Returns the number of messages visible in the last loaded page.
-    int visibleLimit() const { return m_visibleLimit; }
+    /// Returns true if @p pageNumber is in memory; never requests it.
+    bool isResident(qint64 pageNumber) const { return m_pages.contains(pageNumber); }
+
+    /**
+     * @brief Returns a resident page, requesting it if it is missing or out of date.
+     * @param pageNumber The page to look up.
+     * @param loadedUpTo Receives the newest id that existed when the page was read;
+     *        ids above it may be missing from the batch only because they are newer.
+     * @return The page, or nullptr until pageLoaded() reports it.
+     */
+    MessageBatchPtr page(qint64 pageNumber, qint64 *loadedUpTo = nullptr);
+
+    /**
+     * @brief Requests up to @p pageCount pages before the one holding @p beforeId.
+     *
+     * Warms the storage and resident pages so scrolling back is served from memory.
+     */
+    void prefetchOlderPages(qint64 beforeId, int pageCount);
+
+    /**
+     * @brief Tells the pager which ids are on screen after a scroll.
+     *
+     * Updates the scroll velocity estimate and prefetches the pages the view
+     * is heading into: one page, or two when scrolling faster than a page per
+     * kLookAheadMs.
+     *
+     * @param firstId First id on screen.
+     * @param lastId Last id on screen.
+     */
+    void noteVisibleRange(qint64 firstId, qint64 lastId);
+
+    /**
+     * @brief Holds back new page reads, e.g. while the scroll bar thumb is dragged.
+     *
+     * Resident pages are still served. Releasing the hold also forgets the
+     * scroll velocity, since a drag says nothing about where reading continues.
+     */
+    void setRequestsHeld(bool isHeld);
+
+    /// Returns the prefetch counters since construction.
+    const PrefetchStats &prefetchStats() const { return m_prefetchStats; }
+
+    /**
+     * @brief Looks up the first message sent at or after @p time.
+     *
+     * Resolved through the store's time index; seekResolved() follows.
+     * A newer seek supersedes one in flight.
+     */
+    void seekToTime(const QDateTime &time);
 
 signals:
     /**
-     * @brief Emitted when a new page of messages has been fetched.
-     * @param messages List of messages ready for display.
+     * @brief Emitted when a requested page has become resident.
+     *
+     * Only ids the page did not serve before are reported: a re-read of the
+     * tail page names just the appended messages.
+     *
+     * @param firstId First id that became available.
+     * @param lastId Last id that became available.
      */
-    void messagesReady(const QList<Message> &messages);
+    void pageLoaded(qint64 firstId, qint64 lastId);
 
-    /// Emitted after loading a next page to request scrolling the view to the top.
-    void scrollToTopAdjustmentRequested();
+    /// Emitted after reload(); every previously reported row is void.
+    void historyReset();
 
-    /// Emitted after loading a previous page to request scrolling the view to the bottom.
-    void scrollToBottomAdjustmentRequested();
+    /**
+     * @brief Emitted when refreshTail() found new messages.
+     * @param firstNewId Id of the first appended message.
+     * @param lastNewId Id of the last appended message.
+     */
+    void messagesAppended(qint64 firstNewId, qint64 lastNewId);
 
     /**
-     * @brief Emitted to adjust the scroll bar to a specific value.
-     * @param value The scroll bar position to set.
+     * @brief Emitted when a seekToTime() lookup finished.
+     * @param messageId The first message at or after the requested time, or 0 if none.
      */
-    void scrollToValueAdjustmentRequested(int value);
+    void seekResolved(qint64 messageId);
 
 private:
+    /// Default bound on pages kept in memory.
+    static constexpr int kDefaultMaxResidentPages = 48;
+
+    /// Lowest accepted bound: a screen plus the pages being scrolled into.
+    static constexpr int kMinResidentPages = 4;
+
+    /// Scroll distance looked ahead for prefetching, in milliseconds of travel.
+    static constexpr int kLookAheadMs = 500;
+
+    /// Weight of the newest sample in the smoothed scroll velocity.
+    static constexpr double kVelocitySmoothing = 0.5;
+
+    /**
+     * @brief A page held in memory.
+     */
+    struct ResidentPage {
+        MessageBatchPtr batch;     ///< Messages of the page, ascending ids.
+        qint64 loadedUpTo = 0;     ///< Newest id in the store when the page was read.
+        quint64 lastUse = 0;       ///< LRU clock value of the last lookup.
+        bool isUnusedPrefetch = false; ///< Read ahead and not asked for yet.
+    };
+
+    /**
+     * @brief Reads a page asynchronously unless a read is already in flight.
+     * @param pageNumber The page to read.
+     * @param isPrefetch True if the view has not asked for the page yet.
+     */
+    void requestPage(qint64 pageNumber, bool isPrefetch = false);
+
     /**
-     * @brief Clamps the requested offset between 0 and the last possible offset.
-     * @param requestedOffset The desired offset.
-     * @param totalMessages Total number of messages available.
-     * @return A valid offset within [0, maxOffset].
+     * @brief Trims least recently used pages once more than m_maxResidentPages are resident.
+     *
+     * Trims down to three quarters of the bound so the scan runs once per chunk
+     * of loads rather than on every load.
      */
-    int clampOffset(int requestedOffset, int totalMessages) const;
+    void evictPages();
+
+    /**
+     * @brief Re-reads the resident and pending pages holding ids from @p firstId on.
+     *
+     * Each keeps serving its rows until the new copy arrives.
+     */
+    void refreshPagesFrom(qint64 firstId);
+
+    /**
+     * @brief A page holding messages stored below the tail after it was read.
+     */
+    struct Backfill {
+        qint64 firstId = 0;  ///< First id of the page that may have changed.
+        quint64 serial = 0;  ///< m_backfillSerial when the change was noted.
+    };
+
+    MessageStorage *m_store;                 /**< Source of stored chat messages. */
+
+    int     m_messagesPerPage = NUM_MSGS_PER_PAGE; /**< Ids per page. */
+    int     m_maxResidentPages = kDefaultMaxResidentPages; /**< Bound on resident pages. */
+    qint64  m_firstId = 0;                   /**< Oldest id known to the view. */
+    qint64  m_lastId = 0;                    /**< Newest id known to the view. */
+    quint64 m_generation = 0;                /**< Bumped by reload(); older reads are dropped. */
+    quint64 m_seekSerial = 0;                /**< Bumped per seek; stale lookups are dropped. */
+    quint64 m_useClock = 0;                  /**< LRU clock. */
+    quint64 m_backfillSerial = 0;            /**< Bumped per refreshPagesFrom(); reads issued earlier miss the change. */
+    bool    m_requestsHeld = false;          /**< True while new reads are held back. */
 
-    MessageStore     *m_store;           /**< Source of stored chat messages. */
-    ChatFormatter    *m_formatter;       /**< Formatter for message content. */
+    QElapsedTimer m_scrollClock;             /**< Time since the previous noteVisibleRange(). */
+    qint64  m_lastNotedFirstId = -1;         /**< First id of the previous noteVisibleRange(). */
+    double  m_idsPerSecond = 0.0;            /**< Smoothed scroll velocity; negative is towards older ids. */
+    PrefetchStats m_prefetchStats;           /**< Prefetch counters. */
 
-    int   m_currentOffset  = 0;          /**< Currently loaded page start index. */
-    int   m_messagesPerPage= NUM_MSGS_PER_PAGE; /**< Page size. */
-    bool  m_isLoading      = false;      /**< True while a loadPage is in progress. */
-    int   m_lastScrollValue= -1;         /**< Last recorded scroll bar value. */
-    int   m_visibleOffset  = 0;          /**< Offset of first visible message. */
-    qsizetype m_visibleLimit = 0;        /**< Number of visible messages in view. */
-    int   m_currentPage    = 0;          /**< 1-based index of current page. */
-    int   m_totalPages     = 0;          /**< Total number of pages available. */
+    QHash<qint64, ResidentPage> m_pages;     /**< Resident pages by page number. */
+    QSet<qint64> m_pending;                  /**< Pages being read. */
+    QHash<qint64, Backfill> m_backfills;     /**< Pages to read again, by page number. */
 };
 
 #endif // CHATPAGER_H
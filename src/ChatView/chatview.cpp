@@ -0,0 +1,495 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "chatview.h"
+
+#include <QPainter>
+#include <QPaintEvent>
+#include <QResizeEvent>
+#include <QScrollBar>
+
+#include <algorithm>
+
+#include "../Utils/debugmacros.h"
+
+ChatView::ChatView(QWidget *parent)
+    : QAbstractItemView(parent)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    setSelectionMode(QAbstractItemView::NoSelection);
+    setFocusPolicy(Qt::StrongFocus);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setVerticalScrollMode(QAbstractItemView::ScrollPerItem);
+
+    m_seekSettleTimer.setSingleShot(true);
+    m_seekSettleTimer.setInterval(kSeekSettleMs);
+    connect(&m_seekSettleTimer, &QTimer::timeout, this, &ChatView::settleSeek);
+
+    connect(verticalScrollBar(), &QScrollBar::sliderMoved, this, &ChatView::onSliderMoved);
+    connect(verticalScrollBar(), &QScrollBar::sliderReleased, this, &ChatView::settleSeek);
+} //ChatView
+
+void ChatView::onSliderMoved()
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    m_seekSettleTimer.start();
+
+    if (!m_isSeeking) {
+        m_isSeeking = true;
+        emit seekingChanged(true);
+    }
+} //onSliderMoved
+
+void ChatView::settleSeek()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    m_seekSettleTimer.stop();
+
+    if (!m_isSeeking)
+        return;
+
+    m_isSeeking = false;
+    emit seekingChanged(false);
+
+    // Placeholders painted during the drag now request their pages.
+    viewport()->update();
+} //settleSeek
+
+int ChatView::rowCount() const
+{
+    return model() ? model()->rowCount(rootIndex()) : 0;
+} //rowCount
+
+int ChatView::rowHeight(int row) const
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    const auto it = m_rowHeights.constFind(row);
+    if (it != m_rowHeights.constEnd())
+        return it.value();
+
+    QStyleOptionViewItem option;
+    initViewItemOption(&option);
+    option.rect = QRect(0, 0, viewport()->width(), 0);
+
+    const int height = itemDelegate()->sizeHint(option, model()->index(row, 0, rootIndex())).height();
+
+    if (m_rowHeights.size() >= kMaxCachedHeights)
+        m_rowHeights.clear();
+    m_rowHeights.insert(row, height);
+
+    return height;
+} //rowHeight
+
+void ChatView::invalidateRowHeights()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    m_rowHeights.clear();
+    scheduleDelayedItemsLayout();
+} //invalidateRowHeights
+
+int ChatView::topRowAbove(int row, int height) const
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    int used = 0;
+    int top = row;
+
+    for (int r = row, walked = 0; r >= 0 && walked < kMaxLayoutWalk; --r, ++walked) {
+        used += rowHeight(r);
+        if (used > height)
+            return r == row ? row : r + 1;
+        top = r;
+    }
+
+    return top;
+} //topRowAbove
+
+int ChatView::nonEmptyRowFrom(int row, int step) const
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    const int count = rowCount();
+    for (int r = row, walked = 0; r >= 0 && r < count && walked < kMaxLayoutWalk; r += step, ++walked) {
+        if (rowHeight(r) > 0)
+            return r;
+    }
+    return row;
+} //nonEmptyRowFrom
+
+int ChatView::maximumTopRow() const
+{
+    const int count = rowCount();
+    return count > 0 ? topRowAbove(count - 1, viewport()->height()) : 0;
+} //maximumTopRow
+
+QVector<ChatView::RowSpan> ChatView::layoutRows() const
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    QVector<RowSpan> spans;
+    const int count = rowCount();
+    const int height = viewport()->height();
+
+    if (count == 0)
+        return spans;
+
+    // Ids the shared layout never linked to this instance are zero-height rows;
+    // they are measured but not laid out, and a long run of them ends the walk.
+    if (m_followTail) {
+        int y = height;
+        for (int row = count - 1, walked = 0; row >= 0 && y > 0 && walked < kMaxLayoutWalk; --row, ++walked) {
+            const int extent = rowHeight(row);
+            if (extent == 0)
+                continue;
+            y -= extent;
+            spans.append({row, y, extent});
+        }
+        std::reverse(spans.begin(), spans.end());
+
+        // A history shorter than the viewport starts at the top, like a document.
+        if (y > 0) {
+            for (RowSpan &span : spans)
+                span.top -= y;
+        }
+    } else {
+        int y = 0;
+        for (int row = m_topRow, walked = 0; row < count && y < height && walked < kMaxLayoutWalk; ++row, ++walked) {
+            const int extent = rowHeight(row);
+            if (extent == 0)
+                continue;
+            spans.append({row, y, extent});
+            y += extent;
+        }
+    }
+
+    return spans;
+} //layoutRows
+
+int ChatView::firstVisibleRow() const
+{
+    const QVector<RowSpan> spans = layoutRows();
+    return spans.isEmpty() ? -1 : spans.first().row;
+} //firstVisibleRow
+
+int ChatView::lastVisibleRow() const
+{
+    const QVector<RowSpan> spans = layoutRows();
+    return spans.isEmpty() ? -1 : spans.last().row;
+} //lastVisibleRow
+
+void ChatView::setTopRow(int row)
+{
+    verticalScrollBar()->setValue(qBound(0, row, verticalScrollBar()->maximum()));
+} //setTopRow
+
+QRect ChatView::visualRect(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return QRect();
+
+    for (const RowSpan &span : layoutRows()) {
+        if (span.row == index.row())
+            return QRect(0, span.top, viewport()->width(), span.height);
+    }
+
+    return QRect();
+} //visualRect
+
+QModelIndex ChatView::indexAt(const QPoint &point) const
+{
+    for (const RowSpan &span : layoutRows()) {
+        if (point.y() >= span.top && point.y() < span.top + span.height)
+            return model()->index(span.row, 0, rootIndex());
+    }
+
+    return QModelIndex();
+} //indexAt
+
+void ChatView::scrollTo(const QModelIndex &index, ScrollHint hint)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    if (!index.isValid())
+        return;
+
+    const int row = index.row();
+    const int height = viewport()->height();
+
+    switch (hint) {
+    case PositionAtTop:
+        setTopRow(row);
+        break;
+    case PositionAtBottom:
+        setTopRow(topRowAbove(row, height));
+        break;
+    case PositionAtCenter:
+        setTopRow(topRowAbove(row, (height + rowHeight(row)) / 2));
+        break;
+    case EnsureVisible: {
+        const QRect rect = visualRect(index);
+        if (rect.isValid() && rect.top() >= 0 && rect.bottom() < height)
+            return;
+
+        if (row <= firstVisibleRow())
+            setTopRow(row);
+        else
+            setTopRow(topRowAbove(row, height));
+        break;
+    }
+    }
+} //scrollTo
+
+QModelIndex ChatView::moveCursor(CursorAction cursorAction, Qt::KeyboardModifiers modifiers)
+{
+    Q_UNUSED(modifiers);
+
+    const int count = rowCount();
+    if (count == 0)
+        return QModelIndex();
+
+    const int first = qMax(0, firstVisibleRow());
+    const int last = qMax(0, lastVisibleRow());
+
+    int row = 0;
+    ScrollHint hint = PositionAtTop;
+
+    switch (cursorAction) {
+    case MoveUp:
+    case MovePrevious:
+        row = first - 1;
+        break;
+    case MoveDown:
+    case MoveNext:
+        row = last + 1;
+        hint = PositionAtBottom;
+        break;
+    case MovePageUp:
+        row = topRowAbove(first, viewport()->height());
+        break;
+    case MovePageDown:
+        row = last + qMax(1, last - first);
+        hint = PositionAtBottom;
+        break;
+    case MoveHome:
+        row = 0;
+        break;
+    case MoveEnd:
+        row = count - 1;
+        hint = PositionAtBottom;
+        break;
+    default:
+        return currentIndex();
+    }
+
+    // Scroll here: the keys move the viewport, and the current index may not change.
+    const QModelIndex index = model()->index(qBound(0, row, count - 1), 0, rootIndex());
+    scrollTo(index, hint);
+    return index;
+} //moveCursor
+
+int ChatView::horizontalOffset() const
+{
+    return 0;
+} //horizontalOffset
+
+int ChatView::verticalOffset() const
+{
+    return 0;
+} //verticalOffset
+
+bool ChatView::isIndexHidden(const QModelIndex &index) const
+{
+    Q_UNUSED(index);
+    return false;
+} //isIndexHidden
+
+void ChatView::setSelection(const QRect &rect, QItemSelectionModel::SelectionFlags command)
+{
+    // Chat rows are not selectable.
+    Q_UNUSED(rect);
+    Q_UNUSED(command);
+} //setSelection
+
+QRegion ChatView::visualRegionForSelection(const QItemSelection &selection) const
+{
+    Q_UNUSED(selection);
+    return QRegion();
+} //visualRegionForSelection
+
+void ChatView::paintEvent(QPaintEvent *event)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    QPainter painter(viewport());
+
+    if (!m_backgroundImage.isNull()) {
+        // Copy just the exposed part; the source rect is in the pixmap's device pixels.
+        const QPixmap &background = scaledBackground();
+        const qreal ratio = background.devicePixelRatio();
+        const QRect exposed = event->rect();
+        painter.drawPixmap(exposed, background, QRectF(QPointF(exposed.topLeft()) * ratio, QSizeF(exposed.size()) * ratio));
+    }
+
+    QStyleOptionViewItem option;
+    initViewItemOption(&option);
+
+    const int width = viewport()->width();
+
+    for (const RowSpan &span : layoutRows()) {
+        option.rect = QRect(0, span.top, width, span.height);
+        if (span.height == 0 || !event->rect().intersects(option.rect))
+            continue;
+
+        itemDelegate()->paint(&painter, option, model()->index(span.row, 0, rootIndex()));
+    }
+} //paintEvent
+
+void ChatView::setBackgroundImage(const QImage &image)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    m_backgroundImage = image;
+    m_backgroundPixmap = QPixmap();
+
+    viewport()->update();
+} //setBackgroundImage
+
+const QPixmap &ChatView::scaledBackground()
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    const qreal ratio = viewport()->devicePixelRatioF();
+    const QSize size = viewport()->size() * ratio;
+
+    if (m_backgroundPixmap.size() != size) {
+        m_backgroundPixmap = QPixmap::fromImage(m_backgroundImage.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+        m_backgroundPixmap.setDevicePixelRatio(ratio);
+    }
+    return m_backgroundPixmap;
+} //scaledBackground
+
+void ChatView::resizeEvent(QResizeEvent *event)
+{
+    // Heights depend on the width; a height-only resize keeps them.
+    const bool isWidthChanged = event->size().width() != event->oldSize().width();
+    if (isWidthChanged)
+        m_rowHeights.clear();
+
+    QAbstractItemView::resizeEvent(event);
+
+    if (isWidthChanged)
+        emit rowWidthChanged();
+} //resizeEvent
+
+void ChatView::changeEvent(QEvent *event)
+{
+    QAbstractItemView::changeEvent(event);
+
+    if (event->type() == QEvent::PaletteChange || event->type() == QEvent::StyleChange)
+        emit paletteChanged();
+} //changeEvent
+
+void ChatView::scrollContentsBy(int dx, int dy)
+{
+    // Rows are laid out from the scroll bar value; nothing to shift by pixels.
+    Q_UNUSED(dx);
+    Q_UNUSED(dy);
+
+    QScrollBar *bar = verticalScrollBar();
+
+    // A step onto zero-height rows would not move the view; carry on to the next
+    // message in the same direction. Thumb drags map straight to rows instead.
+    if (dy != 0 && !bar->isSliderDown()) {
+        const int row = qMin(nonEmptyRowFrom(bar->value(), dy < 0 ? 1 : -1), bar->maximum());
+        if (row != bar->value()) {
+            const QSignalBlocker blocker(bar);
+            bar->setValue(row);
+        }
+    }
+
+    m_topRow = bar->value();
+    m_followTail = m_topRow >= bar->maximum();
+
+    viewport()->update();
+
+    const QVector<RowSpan> spans = layoutRows();
+    if (!spans.isEmpty())
+        emit visibleRowsChanged(spans.first().row, spans.last().row);
+} //scrollContentsBy
+
+void ChatView::updateGeometries()
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    QScrollBar *bar = verticalScrollBar();
+    const int maximumTop = maximumTopRow();
+    const bool followTail = m_followTail;
+
+    {
+        // Set the range and value together so the intermediate state does not leave tail mode.
+        const QSignalBlocker blocker(bar);
+        bar->setRange(0, maximumTop);
+        bar->setSingleStep(1);
+        bar->setPageStep(qMax(1, int(layoutRows().size()) - 1));
+        bar->setValue(followTail ? maximumTop : qMin(m_topRow, maximumTop));
+    }
+
+    m_topRow = bar->value();
+    m_followTail = followTail || m_topRow >= maximumTop;
+
+    horizontalScrollBar()->setRange(0, 0);
+
+    QAbstractItemView::updateGeometries();
+    viewport()->update();
+} //updateGeometries
+
+void ChatView::reset()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    QAbstractItemView::reset();
+
+    m_rowHeights.clear();
+    m_topRow = 0;
+    m_followTail = true;
+    scheduleDelayedItemsLayout();
+} //reset
+
+void ChatView::dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QList<int> &roles)
+{
+    QAbstractItemView::dataChanged(topLeft, bottomRight, roles);
+
+    // Loaded rows replace placeholders of a different height; only they are measured again.
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row)
+        m_rowHeights.remove(row);
+
+    scheduleDelayedItemsLayout();
+} //dataChanged
+
+void ChatView::rowsInserted(const QModelIndex &parent, int start, int end)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    QAbstractItemView::rowsInserted(parent, start, end);
+    scheduleDelayedItemsLayout();
+} //rowsInserted
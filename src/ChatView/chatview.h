@@ -0,0 +1,222 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHATVIEW_H
+#define CHATVIEW_H
+
+#include <QAbstractItemView>
+#include <QHash>
+#include <QImage>
+#include <QPixmap>
+#include <QTimer>
+#include <QVector>
+
+/**
+ * @class ChatView
+ * @brief Virtualized view showing a chat history one message row at a time.
+ *
+ * Only the rows intersecting the viewport are measured and painted, so opening
+ * or scrolling a history of any length costs the same as showing one screen.
+ * Scrolling is row-granular: the vertical scroll bar position is the row shown
+ * at the top, and its maximum is the top row of the bottom-most screen.
+ *
+ * While scrolled to the bottom the view follows the tail: rows are laid out
+ * upward from the last one, and appended rows stay in view. Scrolling up
+ * leaves that mode; returning to the bottom re-enters it.
+ *
+ * Dragging the scroll bar thumb maps its position straight to a row, and so to
+ * a message id, anywhere in the history. While the thumb moves the view reports
+ * seekingChanged(true) so loading can be held back; once it rests for
+ * kSeekSettleMs or is released, seekingChanged(false) follows and only the
+ * rows then on screen are loaded. Home and End jump to the oldest and newest
+ * message.
+ *
+ * Rows of zero height (ids holding no message) are skipped: they are not laid
+ * out, and a scroll step that lands on them carries on to the next message.
+ * Walks over rows are bounded by kMaxLayoutWalk, so a long run of them costs a
+ * bounded number of measurements and page reads per paint.
+ *
+ * Measured row heights are kept until the model reports the row changed, so
+ * loading a page or appending messages re-measures only the rows involved, and
+ * the row the reader is looking at keeps its place on screen.
+ *
+ * An optional background image is stretched over the viewport. It is scaled
+ * once per viewport size into a cached pixmap, so repaints and scrolling only
+ * copy the exposed part of that pixmap.
+ */
+class ChatView : public QAbstractItemView {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Constructs the view.
+     * @param parent Optional parent widget.
+     */
+    explicit ChatView(QWidget *parent = nullptr);
+
+    QRect visualRect(const QModelIndex &index) const override;
+    void scrollTo(const QModelIndex &index, ScrollHint hint = EnsureVisible) override;
+    QModelIndex indexAt(const QPoint &point) const override;
+
+    /// Returns the first row at least partly on screen, or -1 if there is none.
+    int firstVisibleRow() const;
+
+    /// Returns the last row at least partly on screen, or -1 if there is none.
+    int lastVisibleRow() const;
+
+    /// Returns true while the view keeps the newest row in view.
+    bool isFollowingTail() const { return m_followTail; }
+
+    /// Returns true while the scroll bar thumb is being dragged and has not settled.
+    bool isSeeking() const { return m_isSeeking; }
+
+    /**
+     * @brief Forgets every measured row height and lays the rows out again.
+     *
+     * Needed when the delegate formats rows differently, e.g. after a theme change.
+     */
+    void invalidateRowHeights();
+
+    /**
+     * @brief Paints @p image stretched behind the rows; a null image removes it.
+     *
+     * The image should already be decoded; the view keeps it and scales it only
+     * when the viewport size changes.
+     */
+    void setBackgroundImage(const QImage &image);
+
+signals:
+    /**
+     * @brief Emitted after the user scrolled.
+     * @param firstRow First row on screen.
+     * @param lastRow Last row on screen.
+     */
+    void visibleRowsChanged(int firstRow, int lastRow);
+
+    /**
+     * @brief Emitted when a thumb drag starts moving and when it settles.
+     * @param isSeeking True while the drag is in motion.
+     */
+    void seekingChanged(bool isSeeking);
+
+    /**
+     * @brief Emitted after a resize changed the width rows are laid out at.
+     *
+     * Rows on screen are re-measured as they are painted; the signal lets rows
+     * off screen be refreshed in the background.
+     */
+    void rowWidthChanged();
+
+    /**
+     * @brief Emitted when the view's palette or style changed, e.g. after a stylesheet switch.
+     */
+    void paletteChanged();
+
+public slots:
+    void reset() override;
+
+protected slots:
+    void dataChanged(const QModelIndex &topLeft,
+                     const QModelIndex &bottomRight,
+                     const QList<int> &roles = QList<int>()) override;
+    void rowsInserted(const QModelIndex &parent, int start, int end) override;
+    void updateGeometries() override;
+
+protected:
+    QModelIndex moveCursor(CursorAction cursorAction, Qt::KeyboardModifiers modifiers) override;
+    int horizontalOffset() const override;
+    int verticalOffset() const override;
+    bool isIndexHidden(const QModelIndex &index) const override;
+    void setSelection(const QRect &rect, QItemSelectionModel::SelectionFlags command) override;
+    QRegion visualRegionForSelection(const QItemSelection &selection) const override;
+
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void changeEvent(QEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+
+private:
+    /// Upper bound on rows measured when walking up from a row.
+    static constexpr int kMaxLayoutWalk = 512;
+
+    /// Upper bound on remembered row heights; the cache starts over beyond it.
+    static constexpr int kMaxCachedHeights = 8192;
+
+    /// Time the dragged thumb must rest before the rows under it are loaded.
+    static constexpr int kSeekSettleMs = 120;
+
+    /**
+     * @brief Placement of a row on screen.
+     */
+    struct RowSpan {
+        int row;     ///< Model row.
+        int top;     ///< Viewport y of the row's top edge.
+        int height;  ///< Row height in pixels.
+    };
+
+    /// Returns the model row count, or 0 without a model.
+    int rowCount() const;
+
+    /// Returns the height of @p row at the current width, measuring it on first use.
+    int rowHeight(int row) const;
+
+    /**
+     * @brief Returns the top row of a screen whose last row is @p row.
+     * @param row The row to keep at the bottom.
+     * @param height The height available above and including @p row.
+     */
+    int topRowAbove(int row, int height) const;
+
+    /**
+     * @brief Returns the first row from @p row on, moving by @p step, that has a height.
+     *
+     * Gives up after kMaxLayoutWalk rows and returns @p row.
+     */
+    int nonEmptyRowFrom(int row, int step) const;
+
+    /// Returns the largest top row, i.e. the top row of the bottom-most screen.
+    int maximumTopRow() const;
+
+    /// Lays out the rows intersecting the viewport, top to bottom.
+    QVector<RowSpan> layoutRows() const;
+
+    /// Moves the scroll bar so @p row is shown at the top.
+    void setTopRow(int row);
+
+    /// Starts or extends a seek while the thumb is dragged.
+    void onSliderMoved();
+
+    /// Ends the current seek, if any.
+    void settleSeek();
+
+    /// Returns the background image scaled to the viewport, rescaling it only after a resize.
+    const QPixmap &scaledBackground();
+
+    int  m_topRow = 0;         /**< Row shown at the top unless following the tail. */
+    bool m_followTail = true;  /**< Whether the view is anchored to the last row. */
+
+    bool m_isSeeking = false;  /**< Whether a thumb drag is in motion. */
+    QTimer m_seekSettleTimer;  /**< Ends a seek once the thumb rests. */
+
+    mutable QHash<int, int> m_rowHeights; /**< Measured heights by row at the current width. */
+
+    QImage  m_backgroundImage;  /**< Decoded background image; null if none. */
+    QPixmap m_backgroundPixmap; /**< m_backgroundImage scaled to the viewport. */
+};
+
+#endif // CHATVIEW_H
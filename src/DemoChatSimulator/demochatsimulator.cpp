@@ -6,14 +6,12 @@
 #include <QDir>
 #include <QFileInfoList>
 #include <QFileInfo>
-#include <QTextEdit>
 #include <QRandomGenerator>
 
 
-DemoChatSimulator::DemoChatSimulator(QTextEdit *display, ChatFormatter *formatter, QObject *parent)
+DemoChatSimulator::DemoChatSimulator(int instanceID, QObject *parent)
     : QObject(parent)
-    , chatDisplay(display)
-    , formatter(formatter)
+    , instanceID(instanceID)
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
@@ -27,10 +25,24 @@ bool DemoChatSimulator::startDemo()
     if (!queueMessages())
         return false;
 
+    if (!demoStore) {
+        if (!demoDirectory.isValid()) {
+            qWarning() << "[DemoChatSimulator] Cannot create a temporary directory for the demo store.";
+            return false;
+        }
+
+        demoStore = MessageStorage::create(MessageStorage::kLogBackend, demoDirectory.path(), instanceID, this);
+        if (!demoStore->open()) {
+            qWarning() << "[DemoChatSimulator] Cannot open the demo store in" << demoDirectory.path();
+            delete demoStore;
+            demoStore = nullptr;
+            return false;
+        }
+    }
+
     isRunning = true;
 
     currentIndex = 0;
-    lastUser.clear();
     messageTimer.start(500);
     return true;
 }//startDemo
@@ -44,7 +56,6 @@ void DemoChatSimulator::stopDemo()
 
     currentIndex = 0;
     messageQueue.clear();
-    lastUser.clear();
 
     isRunning = false;
 }//stopDemo
@@ -119,41 +130,15 @@ void DemoChatSimulator::showNextMessage()
 
     const DemoMessage &msg = messageQueue[currentIndex++];
 
-    if (msg.user == "System") {
-        QTextCursor cursor(chatDisplay->document());
-        cursor.movePosition(QTextCursor::End);
-
-        QTextBlockFormat blockFmt;
-        blockFmt.setAlignment(Qt::AlignHCenter); // force center alignment
-        cursor.insertBlock(blockFmt);
-
-        QTextCharFormat charFmt;
-        charFmt.setForeground(Qt::gray);
-        charFmt.setFontItalic(true);
-        charFmt.setFontPointSize(11);
-
-        cursor.insertText("\n" + msg.text, charFmt);
-
-        if(!chatDisplay)
-            return;
-        chatDisplay->setTextCursor(cursor);
-        messageTimer.start(msg.delayMs);
+    // "System" lines are stored as messages from a user of that name; the view
+    // groups consecutive messages by sender on its own.
+    if (!demoStore || demoStore->insertMessage(msg.user, msg.text, QDateTime::currentDateTimeUtc(), msg.isSentByMe) < 0) {
+        qWarning() << "[DemoChatSimulator] Failed to store demo message.";
+        messageTimer.stop();
         return;
     }
 
-
-    // Regular message logic
-    bool showUser = (msg.user != lastUser);
-    lastUser = msg.user;
-
-    const QDateTime now = QDateTime::currentDateTimeUtc();
-    if(!chatDisplay)
-        return;
-    formatter->appendMessage(chatDisplay,
-                             showUser ? msg.user : "",
-                             msg.text,
-                             now,
-                             msg.isSentByMe);
+    emit signalMessageStored();
 
     messageTimer.start(msg.delayMs);
 } //showNextMessage
@@ -21,8 +21,8 @@
 
 #include <QObject>
 #include <QTimer>
-#include <QTextEdit>
 #include <QDateTime>
+#include <QTemporaryDir>
 
 #include <QDir>
 #include <QFile>
@@ -35,7 +35,7 @@
 
 #include <QPointer>
 
-#include "../ChatFormatter/chatformatter.h"
+#include "../MessageStorage/messagestorage.h"
 
 /**
  * @struct DemoMessage
@@ -58,9 +58,13 @@ struct DemoMessage {
  * @brief Simulates a themed, time-based chat conversation for demo purposes.
  *
  * The DemoChatSimulator class injects scripted messages from Wonderland-themed
- * characters (e.g., Alice, Mad Hatter) into a chat display with controlled timing.
+ * characters (e.g., Alice, Mad Hatter) into a chat history with controlled timing.
  * This is used to demonstrate UI features such as message formatting, stacking,
  * and timestamping in a visually dynamic way.
+ *
+ * Messages are written to a throwaway log store in a temporary directory, so the
+ * chat view shows the demo through its usual model and the real history is
+ * never touched.
  */
 class DemoChatSimulator : public QObject {
     Q_OBJECT
@@ -68,11 +72,17 @@ class DemoChatSimulator : public QObject {
 public:
     /**
      * @brief Constructs the demo simulator.
-     * @param display Pointer to the QTextEdit widget used to render chat messages.
-     * @param formatter Pointer to a ChatFormatter used to format each message visually.
+     * @param instanceID Instance id the demo store is created for.
      * @param parent Optional parent QObject for ownership and signal propagation.
      */
-    DemoChatSimulator(QTextEdit *display, ChatFormatter *formatter, QObject *parent = nullptr);
+    explicit DemoChatSimulator(int instanceID, QObject *parent = nullptr);
+
+    /**
+     * @brief Returns the store the demo conversation is written to.
+     *
+     * Valid after a successful startDemo() and owned by the simulator.
+     */
+    MessageStorage *store() const { return demoStore; }
 
     /**
      * @brief Starts the demo conversation playback.
@@ -120,15 +130,19 @@ private:
 
 
     /**
-     * @brief Pointer to the chat display widget where messages are appended.
+     * @brief Instance id the demo store is created for.
      */
+    int instanceID;
 
-    QPointer<QTextEdit> chatDisplay;
+    /**
+     * @brief Temporary directory holding the demo store; removed with the simulator.
+     */
+    QTemporaryDir demoDirectory;
 
     /**
-     * @brief Pointer to the ChatFormatter used to format and color messages.
+     * @brief Store receiving the demo conversation.
      */
-    ChatFormatter *formatter;
+    MessageStorage *demoStore = nullptr;
 
     /**
      * @brief The full list of demo messages to simulate.
@@ -145,11 +159,6 @@ private:
      */
     int currentIndex = 0;
 
-    /**
-     * @brief Tracks the last sender's name to determine whether to show the username again.
-     */
-    QString lastUser;
-
     /**
  * @brief Loads the next demo script from the list of CSV files.
  *
@@ -163,7 +172,7 @@ private:
     bool queueMessages();
 
     /**
-     * @brief Displays the next message in the queue and schedules the next one.
+     * @brief Stores the next message in the queue and schedules the next one.
      */
     void showNextMessage();
 
@@ -218,7 +227,8 @@ private:
     int calculateDynamicDelay(const QString &text) const;
 
 signals:
-    void signalRequestClearChatDisplay();
+    /// Emitted after a demo message was written to store().
+    void signalMessageStored();
 };
 
 #endif // DEMOCHATSIMULATOR_H
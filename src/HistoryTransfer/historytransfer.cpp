@@ -0,0 +1,306 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "historytransfer.h"
+
+#include "../Utils/debugmacros.h"
+
+#include <QDebug>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTimeZone>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace {
+
+const char kBinaryMagic[4] = {'C', 'H', 'T', 'H'};
+constexpr int kBinaryHeaderSize = 8;       // magic + version
+constexpr int kBinaryRecordHeaderSize = 15; // msecs(8) + flags(1) + userLen(2) + textLen(4)
+constexpr quint8 kFlagSentByMe = 0x01;
+
+template <typename T>
+void appendLittleEndian(QByteArray &buffer, T value)
+{
+    char bytes[sizeof(T)];
+    qToLittleEndian<T>(value, bytes);
+    buffer.append(bytes, sizeof(T));
+}
+
+} // namespace
+
+HistoryTransfer::HistoryTransfer(MessageStorage *store, QObject *parent)
+    : QObject(parent)
+    , m_store(store)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+}//HistoryTransfer
+
+HistoryTransfer::Format HistoryTransfer::formatForPath(const QString &path)
+{
+    const bool isJson = path.endsWith(".ndjson", Qt::CaseInsensitive) || path.endsWith(".jsonl", Qt::CaseInsensitive);
+    return isJson ? Format::Ndjson : Format::Binary;
+}//formatForPath
+
+bool HistoryTransfer::fail(const QString &error)
+{
+    m_lastError = error;
+    qWarning().noquote() << "[HistoryTransfer]" << error;
+    return false;
+}//fail
+
+bool HistoryTransfer::exportTo(const QString &path, Format format)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    m_cancelled.store(false);
+    m_processed = 0;
+    m_lastError.clear();
+
+    if (!m_store)
+        return fail(tr("The chat history could not be opened."));
+    m_buffer.clear();
+    m_buffer.reserve(kWriteBufferSize + 4096);
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return fail(tr("Cannot open %1 for writing: %2").arg(path, m_file.errorString()));
+
+    if (format == Format::Binary) {
+        m_buffer.append(kBinaryMagic, sizeof(kBinaryMagic));
+        appendLittleEndian<quint32>(m_buffer, kBinaryVersion);
+    }
+
+    const qint64 total = m_store->messageCount();
+    bool writeFailed = false;
+
+    const bool completed = m_store->forEachMessage([&](const Message &message) {
+        encodeMessage(message, format);
+        ++m_processed;
+
+        if (m_buffer.size() >= kWriteBufferSize && !flushBuffer()) {
+            writeFailed = true;
+            return false;
+        }
+
+        if (m_processed % kProgressInterval == 0) {
+            emit progressChanged(m_processed, total);
+            if (m_cancelled.load())
+                return false;
+        }
+        return true;
+    });
+
+    const bool flushed = !writeFailed && flushBuffer();
+    m_file.close();
+
+    if (writeFailed || !flushed)
+        return fail(tr("Failed writing %1: %2").arg(path, m_file.errorString()));
+    if (m_cancelled.load())
+        return fail(tr("Export cancelled after %1 messages.").arg(m_processed));
+    if (!completed)
+        return fail(tr("Export stopped after %1 messages: database read failed.").arg(m_processed));
+
+    emit progressChanged(m_processed, total);
+    return true;
+}//exportTo
+
+void HistoryTransfer::encodeMessage(const Message &message, Format format)
+{
+    if (format == Format::Ndjson) {
+        QJsonObject object;
+        object.insert("user", message.user);
+        object.insert("text", message.text);
+        object.insert("timestamp", message.timestamp.toUTC().toString(Qt::ISODateWithMs));
+        object.insert("sent", message.isSentByMe);
+
+        m_buffer.append(QJsonDocument(object).toJson(QJsonDocument::Compact));
+        m_buffer.append('\n');
+        return;
+    }
+
+    const QByteArray user = UserDirectory::encodeName(message.user);
+    const QByteArray text = message.text.toUtf8();
+
+    appendLittleEndian<qint64>(m_buffer, message.timestamp.toMSecsSinceEpoch());
+    appendLittleEndian<quint8>(m_buffer, message.isSentByMe ? kFlagSentByMe : 0);
+    appendLittleEndian<quint16>(m_buffer, static_cast<quint16>(user.size()));
+    appendLittleEndian<quint32>(m_buffer, static_cast<quint32>(text.size()));
+    m_buffer.append(user);
+    m_buffer.append(text);
+}//encodeMessage
+
+bool HistoryTransfer::flushBuffer()
+{
+    if (m_buffer.isEmpty())
+        return true;
+
+    const bool ok = m_file.write(m_buffer) == m_buffer.size();
+    m_buffer.clear();
+    return ok;
+}//flushBuffer
+
+bool HistoryTransfer::importFrom(const QString &path, Format format)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    m_cancelled.store(false);
+    m_processed = 0;
+    m_lastError.clear();
+
+    if (!m_store)
+        return fail(tr("The chat history could not be opened."));
+    m_batch.clear();
+    m_batch.reserve(kImportBatchSize);
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return fail(tr("Cannot open %1: %2").arg(path, m_file.errorString()));
+
+    const qint64 size = m_file.size();
+    if (size == 0) {
+        m_file.close();
+        return true;
+    }
+
+    // The mapping is paged in by the OS as the parser advances; nothing is copied up front.
+    const uchar *data = m_file.map(0, size);
+    if (!data) {
+        m_file.close();
+        return fail(tr("Cannot map %1 into memory: %2").arg(path, m_file.errorString()));
+    }
+
+    const bool ok = (format == Format::Ndjson) ? importNdjson(data, size) : importBinary(data, size);
+
+    m_file.unmap(const_cast<uchar *>(data));
+    m_file.close();
+    m_batch.clear();
+    return ok;
+}//importFrom
+
+bool HistoryTransfer::commitBatch(qint64 consumed, qint64 total)
+{
+    if (!m_batch.isEmpty()) {
+        if (!m_store->insertMessages(m_batch))
+            return fail(tr("Database insert failed after %1 messages.").arg(m_processed));
+
+        m_processed += m_batch.size();
+        m_batch.clear();
+    }
+
+    emit progressChanged(consumed, total);
+
+    if (m_cancelled.load())
+        return fail(tr("Import cancelled after %1 messages.").arg(m_processed));
+
+    return true;
+}//commitBatch
+
+bool HistoryTransfer::importNdjson(const uchar *data, qint64 size)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    const char *begin = reinterpret_cast<const char *>(data);
+    const char *end = begin + size;
+    const char *cursor = begin;
+    qint64 lineNumber = 0;
+
+    while (cursor < end) {
+        const char *newline = static_cast<const char *>(std::memchr(cursor, '\n', end - cursor));
+        const char *lineEnd = newline ? newline : end;
+        ++lineNumber;
+
+        if (lineEnd > cursor) {
+            // fromRawData wraps the mapped bytes without copying them.
+            const QByteArray line = QByteArray::fromRawData(cursor, lineEnd - cursor);
+            QJsonParseError error;
+            const QJsonDocument document = QJsonDocument::fromJson(line, &error);
+
+            if (!document.isObject()) {
+                if (!line.trimmed().isEmpty())
+                    return fail(tr("Line %1: %2").arg(lineNumber).arg(error.errorString()));
+            } else {
+                const QJsonObject object = document.object();
+
+                Message message;
+                message.user = object.value("user").toString();
+                message.text = object.value("text").toString();
+                message.timestamp = QDateTime::fromString(object.value("timestamp").toString(), Qt::ISODateWithMs);
+                message.isSentByMe = object.value("sent").toBool();
+
+                if (message.user.isEmpty() || !message.timestamp.isValid())
+                    return fail(tr("Line %1: missing user or timestamp").arg(lineNumber));
+
+                m_batch.append(message);
+            }
+        }
+
+        cursor = newline ? newline + 1 : end;
+
+        if (m_batch.size() >= kImportBatchSize && !commitBatch(cursor - begin, size))
+            return false;
+    }
+
+    return commitBatch(size, size);
+}//importNdjson
+
+bool HistoryTransfer::importBinary(const uchar *data, qint64 size)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    if (size < kBinaryHeaderSize || std::memcmp(data, kBinaryMagic, sizeof(kBinaryMagic)) != 0)
+        return fail(tr("Not a Chester history file."));
+
+    const quint32 version = qFromLittleEndian<quint32>(data + sizeof(kBinaryMagic));
+    if (version != kBinaryVersion)
+        return fail(tr("Unsupported history file version %1.").arg(version));
+
+    qint64 offset = kBinaryHeaderSize;
+
+    while (offset < size) {
+        if (size - offset < kBinaryRecordHeaderSize)
+            return fail(tr("Truncated record at byte %1.").arg(offset));
+
+        const uchar *record = data + offset;
+        const qint64 msecs = qFromLittleEndian<qint64>(record);
+        const quint8 flags = record[8];
+        const quint16 userLength = qFromLittleEndian<quint16>(record + 9);
+        const quint32 textLength = qFromLittleEndian<quint32>(record + 11);
+
+        const qint64 recordSize = kBinaryRecordHeaderSize + qint64(userLength) + qint64(textLength);
+        if (size - offset < recordSize)
+            return fail(tr("Truncated record at byte %1.").arg(offset));
+
+        const char *payload = reinterpret_cast<const char *>(record + kBinaryRecordHeaderSize);
+
+        Message message;
+        message.user = QString::fromUtf8(payload, userLength);
+        message.text = QString::fromUtf8(payload + userLength, textLength);
+        message.timestamp = QDateTime::fromMSecsSinceEpoch(msecs, QTimeZone::UTC);
+        message.isSentByMe = (flags & kFlagSentByMe) != 0;
+        m_batch.append(message);
+
+        offset += recordSize;
+
+        if (m_batch.size() >= kImportBatchSize && !commitBatch(offset, size))
+            return false;
+    }
+
+    return commitBatch(size, size);
+}//importBinary
@@ -0,0 +1,182 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HISTORYTRANSFER_H
+#define HISTORYTRANSFER_H
+
+#include "../MessageStorage/messagestorage.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QObject>
+#include <QString>
+
+#include <atomic>
+
+/**
+ * @class HistoryTransfer
+ * @brief Streams chat history between a MessageStorage backend and NDJSON or binary files.
+ *
+ * Export walks the database with a forward-only cursor and writes through a
+ * bounded output buffer. Import memory-maps the input file, decodes it record by
+ * record, and inserts bounded batches of messages in one transaction each. Neither
+ * direction ever holds the whole history in memory.
+ *
+ * Both operations report progress through progressChanged() and stop at the next
+ * batch boundary after cancel() is called. They may run on a worker thread as
+ * long as the store is used by that thread alone; progressChanged() is then
+ * emitted on the worker and cancel() may be called from any thread.
+ */
+class HistoryTransfer : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Supported file formats.
+     */
+    enum class Format {
+        Ndjson, ///< One JSON object per line: user, text, timestamp (ISO 8601 UTC), sent.
+        Binary  ///< Compact little-endian records behind a "CHTH" header.
+    };
+
+    /**
+     * @brief Constructs a transfer bound to a message store.
+     * @param store The store to read from or write into.
+     * @param parent Optional QObject parent.
+     */
+    explicit HistoryTransfer(MessageStorage *store, QObject *parent = nullptr);
+
+    /**
+     * @brief Chooses a format from a file name: `.ndjson`/`.jsonl` is NDJSON, anything else binary.
+     * @param path The file path.
+     */
+    static Format formatForPath(const QString &path);
+
+    /**
+     * @brief Writes every stored message to @p path.
+     * @param path Destination file, truncated if it exists.
+     * @param format Output format.
+     * @return True if the export completed; false on error or cancellation.
+     */
+    bool exportTo(const QString &path, Format format);
+
+    /**
+     * @brief Appends every message found in @p path to the store.
+     * @param path Source file.
+     * @param format Input format.
+     * @return True if the import completed; false on error or cancellation.
+     *         Batches committed before a failure are kept.
+     */
+    bool importFrom(const QString &path, Format format);
+
+    /**
+     * @brief Binds the transfer to another store, e.g. a worker thread's own connection.
+     * @param store The store to read from or write into; nullptr fails the next transfer.
+     */
+    void setStore(MessageStorage *store) { m_store = store; }
+
+    /**
+     * @brief Requests the running transfer to stop at the next batch boundary.
+     */
+    void cancel() { m_cancelled.store(true); }
+
+    /// Returns true if the last transfer was stopped by cancel().
+    bool wasCancelled() const { return m_cancelled.load(); }
+
+    /// Returns the number of messages written or imported by the last transfer.
+    qint64 processedCount() const { return m_processed; }
+
+    /// Returns a description of the last failure, or an empty string.
+    QString lastError() const { return m_lastError; }
+
+signals:
+    /**
+     * @brief Emitted periodically while a transfer runs.
+     * @param done Units processed so far (messages for export, bytes for import).
+     * @param total Total units, or 0 if unknown.
+     */
+    void progressChanged(qint64 done, qint64 total);
+
+private:
+    /// Messages buffered before each batched insert transaction.
+    static constexpr int kImportBatchSize = 20000;
+
+    /// Bytes buffered in memory before each write to the export file.
+    static constexpr int kWriteBufferSize = 1 << 20;
+
+    /// Messages between two progress notifications during export.
+    static constexpr int kProgressInterval = 4096;
+
+    /// Binary format version written after the magic bytes.
+    static constexpr quint32 kBinaryVersion = 1;
+
+    /**
+     * @brief Appends one message to the output buffer in the given format.
+     * @param message The message to encode.
+     * @param format The output format.
+     */
+    void encodeMessage(const Message &message, Format format);
+
+    /**
+     * @brief Writes the output buffer to the export file and empties it.
+     * @return True on success.
+     */
+    bool flushBuffer();
+
+    /**
+     * @brief Decodes NDJSON records from a mapped file and imports them.
+     * @param data Start of the mapped file.
+     * @param size Size of the mapping in bytes.
+     * @return True if the whole file was imported.
+     */
+    bool importNdjson(const uchar *data, qint64 size);
+
+    /**
+     * @brief Decodes binary records from a mapped file and imports them.
+     * @param data Start of the mapped file.
+     * @param size Size of the mapping in bytes.
+     * @return True if the whole file was imported.
+     */
+    bool importBinary(const uchar *data, qint64 size);
+
+    /**
+     * @brief Inserts the pending batch, reports progress and checks for cancellation.
+     * @param consumed Bytes of input consumed so far.
+     * @param total Total input size in bytes.
+     * @return True if the transfer may continue.
+     */
+    bool commitBatch(qint64 consumed, qint64 total);
+
+    /**
+     * @brief Records an error message and logs it.
+     * @param error Description of the failure.
+     * @return Always false, for convenient returns.
+     */
+    bool fail(const QString &error);
+
+    MessageStorage *m_store;            /**< Store being exported or imported into. */
+    QFile m_file;                       /**< Export destination or import source. */
+    QByteArray m_buffer;                /**< Pending export bytes. */
+    QList<Message> m_batch;             /**< Pending import messages. */
+    qint64 m_processed = 0;             /**< Messages handled by the current transfer. */
+    QString m_lastError;                /**< Last failure description. */
+    std::atomic<bool> m_cancelled{false}; /**< Set by cancel(). */
+};
+
+#endif // HISTORYTRANSFER_H
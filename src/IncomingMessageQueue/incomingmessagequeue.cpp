@@ -0,0 +1,91 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "incomingmessagequeue.h"
+#include "../MessageStorage/messagestorage.h"
+
+#include <utility>
+
+#include "../Utils/debugmacros.h"
+
+IncomingMessageQueue::IncomingMessageQueue(MessageStorage *store, QObject *parent)
+    : QObject(parent)
+    , m_store(store)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(kFrameMs);
+    connect(&m_flushTimer, &QTimer::timeout, this, &IncomingMessageQueue::flush);
+} //IncomingMessageQueue
+
+void IncomingMessageQueue::enqueue(const QString &user, const QString &text, const QDateTime &timestamp)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    Message message;
+    message.user = user;
+    message.text = text;
+    message.timestamp = timestamp;
+    message.isSentByMe = false;
+    m_pending.append(message);
+
+    if (!m_flushTimer.isActive())
+        m_flushTimer.start();
+} //enqueue
+
+void IncomingMessageQueue::flush()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    m_flushTimer.stop();
+
+    if (m_pending.isEmpty())
+        return;
+
+    const QList<Message> messages = std::exchange(m_pending, {});
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!m_store->insertMessages(messages)) {
+        qWarning() << "[IncomingMessageQueue] Failed to store" << messages.size() << "received messages";
+
+        // The insert is all or nothing: keep the batch ahead of anything queued meanwhile.
+        m_pending = messages + m_pending;
+
+        if (++m_failedFlushes > kMaxFlushRetries) {
+            emit storeFailed(m_pending.size());
+            return; // the next enqueue() retries
+        }
+
+        m_flushTimer.setInterval(kMaxIntervalMs);
+        m_flushTimer.start();
+        return;
+    }
+
+    m_failedFlushes = 0;
+    emit flushed(messages.size(), messages.last());
+
+    // The cost includes the view's reaction. Stretch the interval while flushes
+    // overrun the budget, relax it once they don't.
+    const qint64 elapsedMs = timer.elapsed();
+    const int interval = elapsedMs > kFlushBudgetMs ? qMin(m_flushTimer.interval() * 2, kMaxIntervalMs)
+                                                    : qMax(m_flushTimer.interval() / 2, kFrameMs);
+    m_flushTimer.setInterval(interval);
+} //flush
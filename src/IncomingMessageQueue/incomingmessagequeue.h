@@ -0,0 +1,110 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INCOMINGMESSAGEQUEUE_H
+#define INCOMINGMESSAGEQUEUE_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QTimer>
+
+#include "structures.h"
+
+class MessageStorage;
+
+/**
+ * @class IncomingMessageQueue
+ * @brief Coalesces received chat messages into one store write per display frame.
+ *
+ * Storing and showing each datagram as it arrives costs a transaction, a tail
+ * refresh and a layout per message, which a burst of hundreds of messages turns
+ * into a frozen window. Messages are queued instead and flushed at most once per
+ * flush interval with a single insertMessages() call; flushed() then lets the
+ * window refresh the view and notify once for the whole group.
+ *
+ * The interval starts at one frame and adapts: a flush that overruns its frame
+ * budget doubles it, up to kMaxIntervalMs, and quiet flushes shrink it back.
+ * A sustained flood therefore produces fewer, larger groups instead of locking
+ * up the GUI thread.
+ *
+ * A failed insert stores nothing, so its messages go back to the front of the
+ * queue and are retried after kMaxIntervalMs, up to kMaxFlushRetries times in a
+ * row. Past that, storeFailed() reports the failure; the messages stay queued
+ * and the next received message tries again.
+ */
+class IncomingMessageQueue : public QObject {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Constructs the queue.
+     * @param store Storage the messages are written to.
+     * @param parent Optional QObject parent.
+     */
+    explicit IncomingMessageQueue(MessageStorage *store, QObject *parent = nullptr);
+
+    /**
+     * @brief Queues a received message for the next flush.
+     */
+    void enqueue(const QString &user, const QString &text, const QDateTime &timestamp);
+
+    /**
+     * @brief Writes every queued message now.
+     *
+     * Called by the timer; call it directly before the store goes away.
+     */
+    void flush();
+
+    /// Returns the current flush interval in milliseconds.
+    int flushIntervalMs() const { return m_flushTimer.interval(); }
+
+signals:
+    /**
+     * @brief Emitted after queued messages were stored, before the next flush is timed.
+     * @param count Number of messages written by this flush.
+     * @param last The newest message of the flush.
+     */
+    void flushed(int count, const Message &last);
+
+    /**
+     * @brief Emitted when storing has failed kMaxFlushRetries times in a row.
+     * @param count Number of messages waiting to be stored.
+     */
+    void storeFailed(int count);
+
+private:
+    /// Flush interval when traffic is light: one 60 Hz frame.
+    static constexpr int kFrameMs = 16;
+
+    /// Upper bound on the flush interval under a flood.
+    static constexpr int kMaxIntervalMs = 250;
+
+    /// Time a flush may take before the interval is stretched.
+    static constexpr int kFlushBudgetMs = 8;
+
+    /// Failed flushes retried in a row before storeFailed() is reported.
+    static constexpr int kMaxFlushRetries = 5;
+
+    MessageStorage *m_store;   /**< Destination of flushed messages. */
+    QList<Message> m_pending;  /**< Messages received since the last flush. */
+    QTimer m_flushTimer;       /**< Fires the next flush. */
+    int m_failedFlushes = 0;   /**< Failed flushes since the last stored one. */
+};
+
+#endif // INCOMINGMESSAGEQUEUE_H
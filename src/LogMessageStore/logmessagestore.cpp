@@ -0,0 +1,741 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "logmessagestore.h"
+
+#include "../Utils/debugmacros.h"
+
+#include <QByteArrayView>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QTimeZone>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const char kSegmentMagic[4] = {'C', 'H', 'L', 'G'};
+const char kIndexMagic[4] = {'C', 'H', 'I', 'X'};
+
+constexpr qint64 kSegmentHeaderSize = 16;  // magic(4) + version(4) + base id(8)
+constexpr qint64 kRecordHeaderSize = 8;    // payload length(4) + checksum(4)
+constexpr qint64 kPayloadFixedSize = 25;   // id(8) + msecs(8) + flags(1) + user id(4) + text length(4)
+constexpr qint64 kIndexHeaderSize = 24;    // magic(4) + count(4) + segment size(8) + last id(8)
+constexpr qint64 kIndexEntrySize = 20;     // id(8) + msecs(8) + offset(4)
+constexpr qint64 kUserHeaderSize = 6;      // user id(4) + name length(2)
+constexpr quint8 kFlagSentByMe = 0x01;
+
+quint32 payloadChecksum(const uchar *payload, qint64 size)
+{
+    return qChecksum(QByteArrayView(reinterpret_cast<const char *>(payload), size));
+}
+
+template <typename T>
+T readLE(const uchar *source)
+{
+    return qFromLittleEndian<T>(source);
+}
+
+} // namespace
+
+LogMessageStore::LogMessageStore(const QString &directoryPath, QObject *parent)
+    : QObject(parent)
+    , m_directory(directoryPath)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+} //LogMessageStore
+
+LogMessageStore::~LogMessageStore()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    closeSegments();
+} //~LogMessageStore
+
+QString LogMessageStore::segmentPath(qint64 sequence) const
+{
+    return m_directory + QString("/segment_%1.log").arg(sequence, 6, 10, QChar('0'));
+} //segmentPath
+
+QString LogMessageStore::indexPath(const QString &segmentPath)
+{
+    return segmentPath.left(segmentPath.size() - 4) + ".idx";
+} //indexPath
+
+bool LogMessageStore::open()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    closeSegments();
+
+    if (!QDir().mkpath(m_directory)) {
+        qCritical() << "[LogMessageStore] Cannot create log directory:" << m_directory;
+        return false;
+    }
+
+    if (!loadUsers())
+        return false;
+
+    // Zero padded sequence numbers make name order equal creation order.
+    const QStringList files = QDir(m_directory).entryList({"segment_*.log"}, QDir::Files, QDir::Name);
+
+    for (int i = 0; i < files.size(); ++i) {
+        const QString path = m_directory + "/" + files.at(i);
+        const bool active = (i == files.size() - 1);
+
+        m_nextSequence = qMax(m_nextSequence, QFileInfo(path).baseName().mid(8).toLongLong() + 1);
+
+        std::unique_ptr<Segment> segment = openSegment(path, active);
+        if (!segment) {
+            if (!active) {
+                qCritical() << "[LogMessageStore] Unreadable sealed segment:" << path;
+                return false;
+            }
+            // A crash while creating the newest segment leaves a headerless file behind.
+            qWarning() << "[LogMessageStore] Discarding unreadable active segment:" << path;
+            QFile::remove(path);
+            break;
+        }
+
+        m_segments.push_back(std::move(segment));
+    }
+
+    if (m_segments.empty() || m_segments.back()->sealed)
+        return createSegment(m_segments.empty() ? 1 : m_segments.back()->lastId + 1);
+
+    return true;
+} //open
+
+std::unique_ptr<LogMessageStore::Segment> LogMessageStore::openSegment(const QString &path, bool active)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    auto segment = std::make_unique<Segment>();
+    segment->file.setFileName(path);
+
+    if (!segment->file.open(active ? QIODevice::ReadWrite : QIODevice::ReadOnly))
+        return nullptr;
+
+    if (segment->file.size() < kSegmentHeaderSize)
+        return nullptr;
+
+    if (active && segment->file.size() < kSegmentCapacity && !segment->file.resize(kSegmentCapacity))
+        return nullptr;
+
+    segment->mappedSize = segment->file.size();
+    segment->map = segment->file.map(0, segment->mappedSize);
+    if (!segment->map)
+        return nullptr;
+
+    if (std::memcmp(segment->map, kSegmentMagic, sizeof(kSegmentMagic)) != 0
+        || readLE<quint32>(segment->map + 4) != kFormatVersion) {
+        segment->file.unmap(segment->map);
+        return nullptr;
+    }
+
+    segment->baseId = readLE<qint64>(segment->map + 8);
+    segment->lastId = segment->baseId - 1;
+    segment->sealed = !active;
+
+    if (active || !loadIndex(*segment, path))
+        scanSegment(*segment);
+
+    return segment;
+} //openSegment
+
+bool LogMessageStore::createSegment(qint64 baseId)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    auto segment = std::make_unique<Segment>();
+    segment->file.setFileName(segmentPath(m_nextSequence++));
+
+    if (!segment->file.open(QIODevice::ReadWrite | QIODevice::Truncate) || !segment->file.resize(kSegmentCapacity)) {
+        qCritical() << "[LogMessageStore] Cannot create segment:" << segment->file.fileName() << segment->file.errorString();
+        return false;
+    }
+
+    segment->mappedSize = kSegmentCapacity;
+    segment->map = segment->file.map(0, segment->mappedSize);
+    if (!segment->map) {
+        qCritical() << "[LogMessageStore] Cannot map segment:" << segment->file.fileName() << segment->file.errorString();
+        return false;
+    }
+
+    std::memcpy(segment->map, kSegmentMagic, sizeof(kSegmentMagic));
+    qToLittleEndian<quint32>(kFormatVersion, segment->map + 4);
+    qToLittleEndian<qint64>(baseId, segment->map + 8);
+
+    segment->baseId = baseId;
+    segment->lastId = baseId - 1;
+    segment->size = kSegmentHeaderSize;
+
+    m_segments.push_back(std::move(segment));
+    return true;
+} //createSegment
+
+qint64 LogMessageStore::validRecordSize(const Segment &segment, qint64 offset, qint64 limit)
+{
+    if (offset + kRecordHeaderSize + kPayloadFixedSize > limit)
+        return 0;
+
+    const uchar *record = segment.map + offset;
+    const quint32 length = readLE<quint32>(record);
+
+    if (length < kPayloadFixedSize || offset + kRecordHeaderSize + length > limit)
+        return 0;
+
+    const uchar *payload = record + kRecordHeaderSize;
+    if (kPayloadFixedSize + readLE<quint32>(payload + 21) != length)
+        return 0;
+
+    if (readLE<quint32>(record + 4) != payloadChecksum(payload, length))
+        return 0;
+
+    return kRecordHeaderSize + length;
+} //validRecordSize
+
+void LogMessageStore::scanSegment(Segment &segment)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    segment.index.clear();
+
+    const qint64 limit = segment.mappedSize;
+    qint64 offset = kSegmentHeaderSize;
+    qint64 expectedId = segment.baseId;
+
+    while (true) {
+        const qint64 recordSize = validRecordSize(segment, offset, limit);
+        if (recordSize == 0)
+            break;
+
+        const uchar *payload = segment.map + offset + kRecordHeaderSize;
+        if (readLE<qint64>(payload) != expectedId)
+            break;
+
+        if ((expectedId - segment.baseId) % kIndexStride == 0)
+            segment.index.append({expectedId, readLE<qint64>(payload + 8), quint32(offset)});
+
+        offset += recordSize;
+        ++expectedId;
+    }
+
+    segment.size = offset;
+    segment.lastId = expectedId - 1;
+
+    if (!segment.sealed && offset + kRecordHeaderSize <= limit && readLE<quint32>(segment.map + offset) != 0) {
+        // Torn or corrupt tail: clear its length so the cut survives the next crash too.
+        qWarning() << "[LogMessageStore] Recovered log tail at offset" << offset << "in" << segment.file.fileName();
+        qToLittleEndian<quint32>(0, segment.map + offset);
+    }
+} //scanSegment
+
+bool LogMessageStore::rollSegment()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    Segment &active = *m_segments.back();
+    const QString path = active.file.fileName();
+
+    active.file.unmap(active.map);
+    active.map = nullptr;
+    active.file.resize(active.size); // give back the unused preallocation
+    active.file.close();
+
+    if (!active.file.open(QIODevice::ReadOnly)) {
+        qCritical() << "[LogMessageStore] Cannot reopen sealed segment:" << path;
+        return false;
+    }
+
+    active.mappedSize = active.size;
+    active.map = active.file.map(0, active.mappedSize);
+    active.sealed = true;
+
+    if (!active.map) {
+        qCritical() << "[LogMessageStore] Cannot map sealed segment:" << path;
+        return false;
+    }
+
+    saveIndex(active, path);
+    return createSegment(active.lastId + 1);
+} //rollSegment
+
+void LogMessageStore::saveIndex(const Segment &segment, const QString &segmentFile) const
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    QByteArray data(kIndexHeaderSize + segment.index.size() * kIndexEntrySize, Qt::Uninitialized);
+    uchar *out = reinterpret_cast<uchar *>(data.data());
+
+    std::memcpy(out, kIndexMagic, sizeof(kIndexMagic));
+    qToLittleEndian<quint32>(quint32(segment.index.size()), out + 4);
+    qToLittleEndian<qint64>(segment.size, out + 8);
+    qToLittleEndian<qint64>(segment.lastId, out + 16);
+    out += kIndexHeaderSize;
+
+    for (const IndexEntry &entry : segment.index) {
+        qToLittleEndian<qint64>(entry.id, out);
+        qToLittleEndian<qint64>(entry.msecs, out + 8);
+        qToLittleEndian<quint32>(entry.offset, out + 16);
+        out += kIndexEntrySize;
+    }
+
+    QFile file(indexPath(segmentFile));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(data) != data.size())
+        qWarning() << "[LogMessageStore] Cannot write index for" << segmentFile; // rebuilt by scanning on next open
+} //saveIndex
+
+bool LogMessageStore::loadIndex(Segment &segment, const QString &segmentFile) const
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    QFile file(indexPath(segmentFile));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    const QByteArray data = file.readAll();
+    const uchar *in = reinterpret_cast<const uchar *>(data.constData());
+
+    if (data.size() < kIndexHeaderSize || std::memcmp(in, kIndexMagic, sizeof(kIndexMagic)) != 0)
+        return false;
+
+    const quint32 count = readLE<quint32>(in + 4);
+    const qint64 size = readLE<qint64>(in + 8);
+
+    if (size != segment.mappedSize || data.size() != kIndexHeaderSize + qint64(count) * kIndexEntrySize)
+        return false;
+
+    segment.size = size;
+    segment.lastId = readLE<qint64>(in + 16);
+    segment.index.resize(count);
+
+    in += kIndexHeaderSize;
+    for (IndexEntry &entry : segment.index) {
+        entry.id = readLE<qint64>(in);
+        entry.msecs = readLE<qint64>(in + 8);
+        entry.offset = readLE<quint32>(in + 16);
+        in += kIndexEntrySize;
+    }
+
+    return true;
+} //loadIndex
+
+bool LogMessageStore::loadUsers()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    m_users.clear();
+    m_nextUserId = 1;
+
+    if (m_usersFile.isOpen())
+        m_usersFile.close();
+
+    m_usersFile.setFileName(m_directory + "/users.log");
+    if (!m_usersFile.open(QIODevice::ReadWrite)) {
+        qCritical() << "[LogMessageStore] Cannot open users.log:" << m_usersFile.errorString();
+        return false;
+    }
+
+    const QByteArray data = m_usersFile.readAll();
+    const uchar *in = reinterpret_cast<const uchar *>(data.constData());
+    qint64 offset = 0;
+
+    while (offset + kUserHeaderSize <= data.size()) {
+        const int userId = int(readLE<quint32>(in + offset));
+        const quint16 length = readLE<quint16>(in + offset + 4);
+
+        if (offset + kUserHeaderSize + length > data.size())
+            break;
+
+        m_users.insert(userId, QString::fromUtf8(data.constData() + offset + kUserHeaderSize, length));
+        m_nextUserId = qMax(m_nextUserId, userId + 1);
+        offset += kUserHeaderSize + length;
+    }
+
+    if (offset < data.size()) {
+        qWarning() << "[LogMessageStore] Truncating torn users.log tail at" << offset;
+        m_usersFile.resize(offset);
+    }
+
+    return m_usersFile.seek(offset);
+} //loadUsers
+
+int LogMessageStore::resolveUserId(const QString &user)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    const int cachedId = m_users.idForName(user);
+    if (cachedId > 0)
+        return cachedId;
+
+    const QByteArray name = UserDirectory::encodeName(user);
+    const int userId = m_nextUserId;
+
+    QByteArray entry(kUserHeaderSize, Qt::Uninitialized);
+    qToLittleEndian<quint32>(quint32(userId), entry.data());
+    qToLittleEndian<quint16>(quint16(name.size()), entry.data() + 4);
+    entry.append(name);
+
+    // The user must be durable before any record refers to it.
+    if (m_usersFile.write(entry) != entry.size() || !m_usersFile.flush()) {
+        qWarning().nospace() << "[LogMessageStore] Failed to store user '" << user << "': " << m_usersFile.errorString();
+        return -1;
+    }
+
+    ++m_nextUserId;
+    m_users.insert(userId, user);
+    return userId;
+} //resolveUserId
+
+bool LogMessageStore::appendRecord(int userId, const QString &text, const QDateTime &timestamp, bool isSent)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    const QByteArray utf8 = text.toUtf8();
+    const qint64 payloadSize = kPayloadFixedSize + utf8.size();
+    const qint64 recordSize = kRecordHeaderSize + payloadSize;
+
+    if (kSegmentHeaderSize + recordSize > kSegmentCapacity) {
+        qWarning() << "[LogMessageStore] Message too large for a segment:" << recordSize << "bytes";
+        return false;
+    }
+
+    if (m_segments.back()->size + recordSize > m_segments.back()->mappedSize && !rollSegment())
+        return false;
+
+    Segment &segment = *m_segments.back();
+    const qint64 id = segment.lastId + 1;
+    const qint64 msecs = timestamp.toMSecsSinceEpoch();
+
+    uchar *record = segment.map + segment.size;
+    uchar *payload = record + kRecordHeaderSize;
+
+    qToLittleEndian<qint64>(id, payload);
+    qToLittleEndian<qint64>(msecs, payload + 8);
+    payload[16] = isSent ? kFlagSentByMe : 0;
+    qToLittleEndian<quint32>(quint32(userId), payload + 17);
+    qToLittleEndian<quint32>(quint32(utf8.size()), payload + 21);
+    std::memcpy(payload + kPayloadFixedSize, utf8.constData(), utf8.size());
+
+    // Length goes in last so an interrupted append never looks like a complete record.
+    qToLittleEndian<quint32>(payloadChecksum(payload, payloadSize), record + 4);
+    qToLittleEndian<quint32>(quint32(payloadSize), record);
+
+    if ((id - segment.baseId) % kIndexStride == 0)
+        segment.index.append({id, msecs, quint32(segment.size)});
+
+    segment.size += recordSize;
+    segment.lastId = id;
+    return true;
+} //appendRecord
+
+qint64 LogMessageStore::insertMessage(const QString &user, const QString &text, const QDateTime &timestamp, bool isSent)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    const int userId = resolveUserId(user);
+    if (userId < 0 || !appendRecord(userId, text, timestamp, isSent))
+        return -1;
+
+    return m_segments.back()->lastId;
+} //insertMessage
+
+bool LogMessageStore::insertMessages(const QList<Message> &messages)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    for (const Message &message : messages) {
+        const int userId = resolveUserId(message.user);
+        if (userId < 0 || !appendRecord(userId, message.text, message.timestamp, message.isSentByMe))
+            return false;
+    }
+    return true;
+} //insertMessages
+
+Message LogMessageStore::decodeRecord(const Segment &segment, qint64 offset) const
+{
+    const uchar *payload = segment.map + offset + kRecordHeaderSize;
+
+    Message m;
+    m.id = readLE<qint64>(payload);
+    m.timestamp = QDateTime::fromMSecsSinceEpoch(readLE<qint64>(payload + 8), QTimeZone::UTC);
+    m.isSentByMe = (payload[16] & kFlagSentByMe) != 0;
+    m.userId = int(readLE<quint32>(payload + 17));
+    m.user = m_users.name(m.userId); // shares the interned buffer
+    m.text = QString::fromUtf8(reinterpret_cast<const char *>(payload + kPayloadFixedSize), readLE<quint32>(payload + 21));
+    return m;
+} //decodeRecord
+
+void LogMessageStore::decodeRecordInto(MessageBatch &batch, const Segment &segment, qint64 offset)
+{
+    const uchar *payload = segment.map + offset + kRecordHeaderSize;
+    const QString text = QString::fromUtf8(reinterpret_cast<const char *>(payload + kPayloadFixedSize), readLE<quint32>(payload + 21));
+
+    batch.append(readLE<qint64>(payload),
+                 int(readLE<quint32>(payload + 17)),
+                 text,
+                 readLE<qint64>(payload + 8),
+                 (payload[16] & kFlagSentByMe) ? MessageBatch::SentByMe : 0);
+} //decodeRecordInto
+
+LogMessageStore::Segment *LogMessageStore::segmentForId(qint64 id) const
+{
+    auto it = std::upper_bound(m_segments.cbegin(), m_segments.cend(), id, [](qint64 value, const std::unique_ptr<Segment> &segment) {
+        return value < segment->baseId;
+    });
+
+    if (it == m_segments.cbegin())
+        return nullptr;
+
+    Segment *segment = std::prev(it)->get();
+    return id <= segment->lastId ? segment : nullptr;
+} //segmentForId
+
+qint64 LogMessageStore::offsetOfId(const Segment &segment, qint64 id) const
+{
+    auto it = std::upper_bound(segment.index.cbegin(), segment.index.cend(), id, [](qint64 value, const IndexEntry &entry) {
+        return value < entry.id;
+    });
+
+    qint64 offset = kSegmentHeaderSize;
+    qint64 currentId = segment.baseId;
+
+    if (it != segment.index.cbegin()) {
+        --it;
+        offset = it->offset;
+        currentId = it->id;
+    }
+
+    // At most kIndexStride - 1 hops; records were validated when scanned or appended.
+    for (; currentId < id; ++currentId)
+        offset += kRecordHeaderSize + readLE<quint32>(segment.map + offset);
+
+    return offset;
+} //offsetOfId
+
+qint64 LogMessageStore::recordMsecs(const Segment &segment, qint64 offset)
+{
+    return readLE<qint64>(segment.map + offset + kRecordHeaderSize + 8);
+} //recordMsecs
+
+qint64 LogMessageStore::idAtOrAfter(qint64 msecs) const
+{
+    // First segment that starts at or after msecs; the answer is in the one before it, or at its start.
+    auto next = std::partition_point(m_segments.cbegin(), m_segments.cend(), [msecs](const std::unique_ptr<Segment> &segment) {
+        return !segment->index.isEmpty() && segment->index.front().msecs < msecs;
+    });
+
+    if (next != m_segments.cbegin()) {
+        const Segment &segment = **std::prev(next);
+
+        auto entry = std::partition_point(segment.index.cbegin(), segment.index.cend(), [msecs](const IndexEntry &e) {
+            return e.msecs < msecs;
+        });
+        --entry; // the segment's first entry is older than msecs
+
+        // At most kIndexStride hops.
+        qint64 offset = entry->offset;
+        for (qint64 id = entry->id; id <= segment.lastId; ++id) {
+            if (recordMsecs(segment, offset) >= msecs)
+                return id;
+            offset += kRecordHeaderSize + readLE<quint32>(segment.map + offset);
+        }
+    }
+
+    if (next == m_segments.cend() || (*next)->lastId < (*next)->baseId)
+        return 0;
+    return (*next)->baseId;
+} //idAtOrAfter
+
+bool LogMessageStore::walk(qint64 firstId, qint64 lastId, const std::function<bool(const Segment &, qint64)> &visitor) const
+{
+    if (messageCount() == 0)
+        return true;
+
+    qint64 id = qMax(firstId, firstMessageId());
+    lastId = qMin(lastId, lastMessageId());
+
+    while (id <= lastId) {
+        const Segment *segment = segmentForId(id);
+        if (!segment)
+            break;
+
+        qint64 offset = offsetOfId(*segment, id);
+        const qint64 segmentEnd = qMin(lastId, segment->lastId);
+
+        for (; id <= segmentEnd; ++id) {
+            if (!visitor(*segment, offset))
+                return false;
+            offset += kRecordHeaderSize + readLE<quint32>(segment->map + offset);
+        }
+    }
+
+    return true;
+} //walk
+
+MessageBatchPtr LogMessageStore::fetchMessageRange(qint64 firstId, qint64 lastId)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    auto batch = std::make_shared<MessageBatch>();
+    if (lastId >= firstId)
+        batch->reserve(int(qMin<qint64>(lastId - firstId + 1, messageCount())));
+
+    walk(firstId, lastId, [&batch](const Segment &segment, qint64 offset) {
+        decodeRecordInto(*batch, segment, offset);
+        return true;
+    });
+    return batch;
+} //fetchMessageRange
+
+MessageBatchPtr LogMessageStore::fetchMessagesBetween(const QDateTime &from, const QDateTime &to, int limit)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    auto batch = std::make_shared<MessageBatch>();
+    const qint64 firstId = idAtOrAfter(from.toMSecsSinceEpoch());
+    if (firstId == 0 || limit <= 0)
+        return batch;
+
+    const qint64 toMsecs = to.toMSecsSinceEpoch();
+    walk(firstId, firstId + limit - 1, [&batch, toMsecs](const Segment &segment, qint64 offset) {
+        if (recordMsecs(segment, offset) >= toMsecs)
+            return false;
+        decodeRecordInto(*batch, segment, offset);
+        return true;
+    });
+    return batch;
+} //fetchMessagesBetween
+
+qint64 LogMessageStore::firstMessageIdAt(const QDateTime &time)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    return idAtOrAfter(time.toMSecsSinceEpoch());
+} //firstMessageIdAt
+
+MessageBatchPtr LogMessageStore::fetchLastMessages(int count)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    const qint64 last = lastMessageId();
+    return fetchMessageRange(qMax(firstMessageId(), last - count + 1), last);
+} //fetchLastMessages
+
+MessageBatchPtr LogMessageStore::fetchMessagesAfter(qint64 afterId, int limit)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    const qint64 first = qMax(afterId + 1, firstMessageId());
+    return fetchMessageRange(first, first + limit - 1);
+} //fetchMessagesAfter
+
+MessageBatchPtr LogMessageStore::fetchMessagesBefore(qint64 beforeId, int limit)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    const qint64 last = qMin(beforeId - 1, lastMessageId());
+    return fetchMessageRange(qMax(firstMessageId(), last - limit + 1), last);
+} //fetchMessagesBefore
+
+bool LogMessageStore::forEachMessage(const std::function<bool(const Message &)> &visitor)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    return walk(firstMessageId(), lastMessageId(), [this, &visitor](const Segment &segment, qint64 offset) {
+        return visitor(decodeRecord(segment, offset));
+    });
+} //forEachMessage
+
+int LogMessageStore::messageCount() const
+{
+    if (m_segments.empty())
+        return 0;
+
+    return int(m_segments.back()->lastId - m_segments.front()->baseId + 1);
+} //messageCount
+
+qint64 LogMessageStore::firstMessageId() const
+{
+    return messageCount() > 0 ? m_segments.front()->baseId : 0;
+} //firstMessageId
+
+qint64 LogMessageStore::lastMessageId() const
+{
+    return messageCount() > 0 ? m_segments.back()->lastId : 0;
+} //lastMessageId
+
+void LogMessageStore::closeSegments()
+{
+    for (const std::unique_ptr<Segment> &segment : m_segments) {
+        if (segment->map)
+            segment->file.unmap(segment->map);
+        segment->file.close();
+    }
+    m_segments.clear();
+} //closeSegments
+
+bool LogMessageStore::clearMessages()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    // Keep ids monotonic across a clear so cached pages can never alias new rows.
+    const qint64 nextId = m_segments.empty() ? 1 : m_segments.back()->lastId + 1;
+
+    QStringList files;
+    for (const std::unique_ptr<Segment> &segment : m_segments)
+        files << segment->file.fileName();
+
+    closeSegments();
+
+    for (const QString &file : std::as_const(files)) {
+        QFile::remove(file);
+        QFile::remove(indexPath(file));
+    }
+
+    return createSegment(nextId);
+} //clearMessages
+
+bool LogMessageStore::pruneMessages(int keepCount)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    // Whole sealed segments are dropped, so slightly more than keepCount may remain.
+    const qint64 cutoff = lastMessageId() - qMax(0, keepCount) + 1;
+
+    while (m_segments.size() > 1 && m_segments.front()->lastId < cutoff) {
+        Segment &oldest = *m_segments.front();
+        const QString file = oldest.file.fileName();
+
+        oldest.file.unmap(oldest.map);
+        oldest.file.close();
+        m_segments.erase(m_segments.begin());
+
+        if (!QFile::remove(file)) {
+            qWarning() << "[LogMessageStore] Failed to remove pruned segment:" << file;
+            return false;
+        }
+        QFile::remove(indexPath(file));
+    }
+
+    return true;
+} //pruneMessages
@@ -0,0 +1,248 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOGMESSAGESTORE_H
+#define LOGMESSAGESTORE_H
+
+#include "../MessageStorage/messagestorage.h"
+
+#include <QFile>
+#include <QObject>
+#include <QVector>
+
+#include <memory>
+#include <vector>
+
+/**
+ * @class LogMessageStore
+ * @brief Append-only chat history stored in memory-mapped segment files.
+ *
+ * Messages are appended as checksummed records to the active segment, which is
+ * preallocated and mapped read/write so an append is a memcpy. Full segments are
+ * sealed: truncated to their used size, given a persisted sparse index and
+ * remapped. Sender names live once in `users.log`; records only store the user id.
+ *
+ * Ids are contiguous inside the log, so range reads locate the first record
+ * through the sparse id/time index (one entry every kIndexStride records) and
+ * then walk forward. Time seeks binary-search the same index, which assumes
+ * records are appended in timestamp order (true for live traffic and exports). On open, the active segment is scanned and the log is cut
+ * at the first torn or corrupt record, which makes a crash mid-append lose at
+ * most that record.
+ *
+ * On-disk layout of `<dir>/segment_<n>.log`:
+ *  - header: "CHLG", u32 version, i64 base id
+ *  - records: u32 payload length, u32 checksum, payload
+ *  - payload: i64 id, i64 msecs since epoch (UTC), u8 flags, u32 user id, u32 text length, UTF-8 text
+ */
+class LogMessageStore : public QObject, public MessageStorage {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Constructs a log store rooted at @p directoryPath.
+     * @param directoryPath Directory holding segment files; created on open().
+     * @param parent Optional parent QObject.
+     */
+    explicit LogMessageStore(const QString &directoryPath, QObject *parent = nullptr);
+
+    /**
+     * @brief Seals the mappings and closes every segment.
+     */
+    ~LogMessageStore() override;
+
+    bool open() override;
+    qint64 insertMessage(const QString &user, const QString &text, const QDateTime &timestamp, bool isSent) override;
+    bool insertMessages(const QList<Message> &messages) override;
+    MessageBatchPtr fetchLastMessages(int count) override;
+    MessageBatchPtr fetchMessagesAfter(qint64 afterId, int limit) override;
+    MessageBatchPtr fetchMessagesBefore(qint64 beforeId, int limit) override;
+    MessageBatchPtr fetchMessageRange(qint64 firstId, qint64 lastId) override;
+    MessageBatchPtr fetchMessagesBetween(const QDateTime &from, const QDateTime &to, int limit) override;
+    qint64 firstMessageIdAt(const QDateTime &time) override;
+    bool forEachMessage(const std::function<bool(const Message &)> &visitor) override;
+    int messageCount() const override;
+    qint64 firstMessageId() const override;
+    qint64 lastMessageId() const override;
+    bool clearMessages() override;
+    bool pruneMessages(int keepCount) override;
+    const UserDirectory &users() const override { return m_users; }
+
+private:
+    /// Preallocated size of a segment file.
+    static constexpr qint64 kSegmentCapacity = 64 * 1024 * 1024;
+
+    /// One sparse index entry is kept every kIndexStride records.
+    static constexpr int kIndexStride = 32;
+
+    /// On-disk format version written in every segment header.
+    static constexpr quint32 kFormatVersion = 1;
+
+    /**
+     * @struct IndexEntry
+     * @brief Sparse index entry locating one record inside a segment.
+     */
+    struct IndexEntry {
+        qint64 id = 0;     ///< Message id of the record.
+        qint64 msecs = 0;  ///< Message timestamp, for time range seeks.
+        quint32 offset = 0; ///< Byte offset of the record inside the segment.
+    };
+
+    /**
+     * @struct Segment
+     * @brief One mapped segment file.
+     */
+    struct Segment {
+        QFile file;                 ///< Open segment file.
+        uchar *map = nullptr;       ///< Mapping of the whole file.
+        qint64 mappedSize = 0;      ///< Size of the mapping.
+        qint64 size = 0;            ///< Bytes holding valid data (header + records).
+        qint64 baseId = 1;          ///< Id of the first record in this segment.
+        qint64 lastId = 0;          ///< Id of the last record, baseId - 1 if empty.
+        bool sealed = false;        ///< True once the segment no longer accepts appends.
+        QVector<IndexEntry> index;  ///< Sparse id/time index.
+    };
+
+    /**
+     * @brief Returns the path of segment number @p sequence.
+     */
+    QString segmentPath(qint64 sequence) const;
+
+    /**
+     * @brief Returns the path of the sparse index file for a segment file.
+     */
+    static QString indexPath(const QString &segmentPath);
+
+    /**
+     * @brief Opens and maps an existing segment.
+     * @param path Segment file path.
+     * @param active True for the last segment, which is recovered and stays writable.
+     * @return The segment, or nullptr if the file is unusable.
+     */
+    std::unique_ptr<Segment> openSegment(const QString &path, bool active);
+
+    /**
+     * @brief Creates a new empty active segment.
+     * @param baseId Id of the first record the segment will hold.
+     * @return True on success.
+     */
+    bool createSegment(qint64 baseId);
+
+    /**
+     * @brief Scans a segment's records, rebuilding its index and finding the valid end.
+     *
+     * Stops at the first record that is truncated, fails its checksum or breaks id
+     * contiguity; everything before it is kept.
+     *
+     * @param segment The segment to scan; size, lastId and index are updated.
+     */
+    void scanSegment(Segment &segment);
+
+    /**
+     * @brief Seals the active segment and opens a new one after it.
+     * @return True on success.
+     */
+    bool rollSegment();
+
+    /**
+     * @brief Writes the sparse index of a sealed segment next to it.
+     */
+    void saveIndex(const Segment &segment, const QString &segmentFile) const;
+
+    /**
+     * @brief Loads a persisted sparse index if it matches the segment.
+     * @return True if the index was loaded.
+     */
+    bool loadIndex(Segment &segment, const QString &segmentFile) const;
+
+    /**
+     * @brief Loads `users.log` into the user directory, truncating a torn tail.
+     */
+    bool loadUsers();
+
+    /**
+     * @brief Returns the id for a sender, appending it to `users.log` if new.
+     * @return The user id, or -1 on failure.
+     */
+    int resolveUserId(const QString &user);
+
+    /**
+     * @brief Appends one record to the active segment.
+     * @return True on success.
+     */
+    bool appendRecord(int userId, const QString &text, const QDateTime &timestamp, bool isSent);
+
+    /**
+     * @brief Validates the record at @p offset.
+     * @param segment The segment holding the record.
+     * @param offset Byte offset of the record.
+     * @param limit End of the readable region.
+     * @return The total record size in bytes, or 0 if the record is invalid.
+     */
+    static qint64 validRecordSize(const Segment &segment, qint64 offset, qint64 limit);
+
+    /**
+     * @brief Decodes the record at @p offset.
+     */
+    Message decodeRecord(const Segment &segment, qint64 offset) const;
+
+    /**
+     * @brief Appends the record at @p offset to @p batch without building a Message.
+     */
+    static void decodeRecordInto(MessageBatch &batch, const Segment &segment, qint64 offset);
+
+    /**
+     * @brief Returns the segment holding @p id, or nullptr if out of range.
+     */
+    Segment *segmentForId(qint64 id) const;
+
+    /**
+     * @brief Returns the byte offset of record @p id inside @p segment using the sparse index.
+     */
+    qint64 offsetOfId(const Segment &segment, qint64 id) const;
+
+    /**
+     * @brief Returns the id of the first record with a timestamp >= @p msecs, or 0 if none.
+     */
+    qint64 idAtOrAfter(qint64 msecs) const;
+
+    /**
+     * @brief Returns the timestamp of the record at @p offset.
+     */
+    static qint64 recordMsecs(const Segment &segment, qint64 offset);
+
+    /**
+     * @brief Visits records with ids in [firstId, lastId] in ascending order.
+     * @param visitor Receives the segment and byte offset of each record; return false to stop early.
+     * @return False if the visitor stopped the walk.
+     */
+    bool walk(qint64 firstId, qint64 lastId, const std::function<bool(const Segment &, qint64)> &visitor) const;
+
+    /**
+     * @brief Unmaps and closes all segments.
+     */
+    void closeSegments();
+
+    QString m_directory;                            /**< Root directory of the log. */
+    std::vector<std::unique_ptr<Segment>> m_segments; /**< Segments ordered by base id; last is active. */
+    qint64 m_nextSequence = 1;                      /**< Number given to the next segment file. */
+    QFile m_usersFile;                              /**< Append handle for `users.log`. */
+    UserDirectory m_users;                          /**< Interned senders. */
+    int m_nextUserId = 1;                           /**< Id given to the next new sender. */
+};
+
+#endif // LOGMESSAGESTORE_H
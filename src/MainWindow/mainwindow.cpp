@@ -19,6 +19,14 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "../ToastNotification/toastnotification.h"
+#include "../HistoryTransfer/historytransfer.h"
+#include "../MessageStore/messagestore.h"
+
+#include <QFileDialog>
+#include <QProgressDialog>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <utility>
 
 
 #include "../Utils/debugmacros.h"
@@ -95,6 +103,27 @@ QString MainWindow::buildAboutText(const QString &version, const QString &compil
     about += QString(" - %1%2\n").arg(tr("Release date: "), releaseDate);
     about += QString(" - %1%2\n").arg(tr("Compiler: "), compilerInfo);
     about += QString(" - %1%2\n").arg(tr("Running on: "), SYSTEMINFO);
+
+    const StyleManager::SwitchTiming &timing = styleManager->switchTiming();
+    if (timing.switches > 0) {
+        about += QString(" - %1%2\n").arg(tr("Theme switch: "),
+                                         tr("%1 ms last, %2 ms average, %3 ms slowest over %4 switches")
+                                             .arg(timing.lastMs, 0, 'f', 1)
+                                             .arg(timing.totalMs / timing.switches, 0, 'f', 1)
+                                             .arg(timing.slowestMs, 0, 'f', 1)
+                                             .arg(timing.switches));
+    }
+
+    if (const auto *store = dynamic_cast<const MessageStore *>(messageStore)) {
+        const MessagePageCache &cache = store->pageCache();
+        const quint64 lookups = cache.hits() + cache.misses();
+        if (lookups > 0) {
+            about += QString(" - %1%2\n").arg(tr("Page cache: "),
+                                             tr("%1 of %2 lookups served from memory")
+                                                 .arg(cache.hits())
+                                                 .arg(lookups));
+        }
+    }
     about += separator;
     about += QString("%1\n").arg(WARRANTY);
     about += separator;
@@ -200,15 +229,16 @@ bool MainWindow::isValidIPv4Address(const QString &ip) const
     return !ip.contains(":") && !ip.startsWith("169.254");
 } //isValidIPv4Address
 
-void MainWindow::fillNetworkWidgets()
+void MainWindow::fillNetworkWidgets(const QList<QHostAddress> &addresses)
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
+    // Refilling must not overwrite the saved choice through currentTextChanged.
+    QSignalBlocker block(ui->comboBoxLocalUDPNetwork);
+
     ui->comboBoxLocalUDPNetwork->clear();
     ui->comboBoxLocalUDPNetwork->addItem("ANY");
 
-    const QList<QHostAddress> addresses = QNetworkInterface::allAddresses();
-
     for (const QHostAddress &address : addresses) {
         const QString ip = address.toString();
 
@@ -216,6 +246,8 @@ void MainWindow::fillNetworkWidgets()
             ui->comboBoxLocalUDPNetwork->addItem(ip);
         }
     }
+
+    ui->comboBoxLocalUDPNetwork->setCurrentText(configSettings.localUDPAddress);
 } //fillNetworkWidgets
 
 void MainWindow::updateUIWidgets()
@@ -241,6 +273,57 @@ void MainWindow::updateUIWidgets()
     ui->comboBoxSelectStyleSheet->setCurrentText(configSettings.stylesheetName);
 } //updateUIWidgets
 
+void MainWindow::prelayoutChatRows()
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    const int firstRow = ui->chatView->firstVisibleRow();
+    if (firstRow >= 0)
+        chatDelegate->prelayoutRows(chatModel, firstRow, ui->chatView->lastVisibleRow());
+} //prelayoutChatRows
+
+void MainWindow::markVisibleRowsRead()
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+#ifdef ENABLE_DEMO_MODE
+    if (isDemoRunning)
+        return; // demo ids belong to the demo's own store
+#endif
+
+    if (!isActiveWindow() || ui->tabWidget->currentWidget() != ui->tabChat)
+        return;
+
+    const int lastRow = ui->chatView->lastVisibleRow();
+    if (lastRow < 0)
+        return;
+
+    const qint64 id = chatModel->idForRow(lastRow);
+    if (id <= lastReadId)
+        return;
+
+    lastReadId = id;
+    lastReadSaveDebounceTimer.start();
+    updateUnreadCount();
+} //markVisibleRowsRead
+
+void MainWindow::updateUnreadCount()
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+#ifdef ENABLE_DEMO_MODE
+    if (isDemoRunning)
+        return;
+#endif
+
+    // Ids are assigned in arrival order, so the unread messages are the ones above lastReadId;
+    // the store counts them, since shared-layout ids are not dense.
+    const qint64 unread = chatPager->store()->messageCountAfter(lastReadId);
+
+    ui->pushButtonJumpToUnread->setEnabled(unread > 0);
+    ui->pushButtonJumpToUnread->setText(unread > 0 ? tr("%1 unread").arg(unread) : tr("No unread"));
+} //updateUnreadCount
+
 void MainWindow::setStyleSheet()
 {
     LOG_DEBUG(Q_FUNC_INFO);
@@ -261,60 +344,49 @@ void MainWindow::setStyleSheet()
     }
 } //setStyleSheet
 
-QString MainWindow::chatBackgroundStyle() const
-{
-    LOG_DEBUG(Q_FUNC_INFO);
-
-    return QStringLiteral("QTextEdit#textEditChat { "
-                          "border-image: url(:/images/BackgroundImage10.png); "
-                          "}");
-} //chatBackgroundStyle
-
 void MainWindow::setBackgroundImage()
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
-    if (configSettings.b_displayBackgroundImage) {
-        ui->textEditChat->setStyleSheet(chatBackgroundStyle());
-    } else {
-        ui->textEditChat->setStyleSheet(QString()); // reset to default
+    if (!configSettings.b_displayBackgroundImage) {
+        ui->chatView->setBackgroundImage(QImage());
+        return;
     }
-} //setBackgroundImage
 
-void MainWindow::displayMessages(const QList<Message> &messages)
-{
-    LOG_DEBUG(Q_FUNC_INFO);
-
-    // visibleOffset = currentOffset;
-    // visibleLimit = messages.count();
-
-    ui->textEditChat->clear();
+    // Decoded once; the view scales it per viewport size and paints it directly.
+    if (chatBackgroundImage.isNull())
+        chatBackgroundImage = QImage(":/images/BackgroundImage10.png");
 
-    QString previousUser;
-    for (const Message &msg : messages) {
-        bool showUserName = (msg.user != previousUser);
-        previousUser = msg.user;
-
-        m_formatter->appendMessage(ui->textEditChat, showUserName ? msg.user : "", msg.text, msg.timestamp, msg.isSentByMe);
-    }
-} //displayMessages
+    ui->chatView->setBackgroundImage(chatBackgroundImage);
+} //setBackgroundImage
 
 bool MainWindow::eventFilter(QObject *obj, QEvent *event)
 {
     // LOG_DEBUG(Q_FUNC_INFO);
 
-    if (obj == ui->textEditChat->verticalScrollBar() && event->type() == QEvent::Type::Wheel) {
-        QWheelEvent *wheelEvent = static_cast<QWheelEvent *>(event);
-        const int delta = wheelEvent->angleDelta().y();
-        const bool scrollingDown = delta < 0;
-
-        if (chatPager)
-            chatPager->handleScroll(ui->textEditChat->verticalScrollBar(), scrollingDown);
+    if (isFirstPaintPending && obj == ui->chatView->viewport() && event->type() == QEvent::Paint) {
+        isFirstPaintPending = false;
+        isStartupComplete = true;
+        // Let this paint finish before any further startup work.
+        QTimer::singleShot(0, this, &MainWindow::finishStartup);
     }
 
     return QMainWindow::eventFilter(obj, event);
 } //eventFilter
 
+void MainWindow::changeEvent(QEvent *event)
+{
+    QMainWindow::changeEvent(event);
+
+    if (event->type() != QEvent::ActivationChange || !ui || !chatModel)
+        return;
+
+    if (isActiveWindow())
+        markVisibleRowsRead();
+    else
+        chatModel->setLastReadMarker(lastReadId);
+} //changeEvent
+
 
 #ifdef EXPIRES
 bool MainWindow::isTooOld()
@@ -366,10 +438,13 @@ void MainWindow::initializeManagers()
     udpManager = new UdpChatSocketManager(this);
     m_formatter = new ChatFormatter(this);
 
-    const QString dbPath = QCoreApplication::applicationDirPath() + QString("/chat_messages_instance_%1.db").arg(instanceID);
-    messageStore = new MessageStore(dbPath, instanceID, this);
+    messageStore = MessageStorage::create(settingsManager->loadStorageBackend(), QCoreApplication::applicationDirPath(), instanceID, this);
 
-    chatPager = std::make_unique<ChatPager>(messageStore, m_formatter, this);
+    incomingQueue = new IncomingMessageQueue(messageStore, this);
+
+    chatPager = std::make_unique<ChatPager>(messageStore, this);
+    chatModel = new ChatMessageModel(chatPager.get(), this);
+    chatDelegate = new ChatMessageDelegate(m_formatter, this);
 
 } //initializeManagers
 
@@ -384,7 +459,10 @@ void MainWindow::initializeUi()
     ui->tabWidget->setCurrentIndex(1);
     ui->tabWidget->setTabEnabled(0, false); // Disable Chat tab
     ui->statusbar->addWidget(ui->labelStatus);
-    ui->textEditChat->verticalScrollBar()->installEventFilter(this);
+    ui->chatView->setItemDelegate(chatDelegate);
+    ui->chatView->setModel(chatModel);
+    ui->chatView->viewport()->installEventFilter(this);
+    ui->dateTimeEditJumpToDate->setDateTime(QDateTime::currentDateTime());
 } //initializeUi
 
 void MainWindow::connectSignals()
@@ -392,14 +470,27 @@ void MainWindow::connectSignals()
     LOG_DEBUG(Q_FUNC_INFO);
 
     connect(udpManager, &UdpChatSocketManager::messageReceived, this, [this](const QString &user, const QString &msg) {
-        const QDateTime timestamp = QDateTime::currentDateTimeUtc();
-        messageStore->insertMessage(user, msg, timestamp, false);
-        m_formatter->appendMessage(ui->textEditChat, user, msg, timestamp, false);
-        ui->textEditChat->moveCursor(QTextCursor::End);
+        incomingQueue->enqueue(user, msg, QDateTime::currentDateTimeUtc());
+    });
+
+    connect(incomingQueue, &IncomingMessageQueue::storeFailed, this, [this](int count) {
+        ui->labelStatus->setText(tr("Cannot save received messages: %1 waiting to be stored.").arg(count));
+    });
+
+    // One tail refresh, one layout and at most one notification per flushed group.
+    connect(incomingQueue, &IncomingMessageQueue::flushed, this, [this](int count, const Message &last) {
+        chatPager->refreshTail();
+        markVisibleRowsRead();
+        updateUnreadCount();
+
+        const QString summary = count == 1 ? QString("%1: %2").arg(last.user, last.text)
+                                           : tr("%1 new messages").arg(count);
 
         if (isMinimized() || !isVisible() || !isActiveWindow()) {
             QApplication::alert(this, 3000);
-            new ToastNotification(QString("%1: %2").arg(user, msg), this);
+            new ToastNotification(summary, this);
+        } else if (!ui->chatView->isFollowingTail()) {
+            ui->statusbar->showMessage(summary, 3000);
         }
     });
 
@@ -412,25 +503,54 @@ void MainWindow::connectSignals()
     });
 
     connect(this, &MainWindow::signalRequestRedrawCurrentMessages, this, &MainWindow::redrawCurrentMessages);
+    connect(ui->chatView, &ChatView::paletteChanged, this, &MainWindow::updateChatTheme);
 
-    connect(chatPager.get(), &ChatPager::messagesReady, this, &MainWindow::displayMessages);
+    // Ids restart after a clear or a store switch, so cached documents may no longer match.
+    connect(chatModel, &QAbstractItemModel::modelReset, chatDelegate, &ChatMessageDelegate::invalidate);
 
+    connect(chatPager.get(), &ChatPager::pageLoaded, this, [this]() {
+        if (!isStartupComplete)
+            isFirstPaintPending = true;
 
+        prelayoutChatRows();
+    });
+
+    // Off-screen rows are re-laid out in the background; rows on screen are laid out by the paint.
+    connect(ui->chatView, &ChatView::rowWidthChanged, this, &MainWindow::prelayoutChatRows, Qt::QueuedConnection);
+
+    // Dragging the thumb across the history must not queue a read per position passed.
+    connect(ui->chatView, &ChatView::seekingChanged, chatPager.get(), &ChatPager::setRequestsHeld);
 
-    connect(chatPager.get(), &ChatPager::scrollToTopAdjustmentRequested, this, [this]() {
-        QScrollBar *sb = ui->textEditChat->verticalScrollBar();
-        if (sb)
-            sb->setValue(sb->minimum() + 1);
+    connect(ui->chatView, &ChatView::visibleRowsChanged, this, [this](int firstRow, int lastRow) {
+        chatPager->noteVisibleRange(chatModel->idForRow(firstRow), chatModel->idForRow(lastRow));
+        chatDelegate->prelayoutRows(chatModel, firstRow, lastRow);
+        markVisibleRowsRead();
     });
-    connect(chatPager.get(), &ChatPager::scrollToBottomAdjustmentRequested, this, [this]() {
-        QScrollBar *sb = ui->textEditChat->verticalScrollBar();
-        if (sb)
-            sb->setValue(sb->maximum());
+
+    connect(chatModel, &QAbstractItemModel::modelReset, this, [this]() {
+        // A cleared or pruned history restarts below the old ids.
+        if (lastReadId > chatPager->lastId()) {
+            lastReadId = chatPager->lastId();
+            lastReadSaveDebounceTimer.start();
+        }
+        updateUnreadCount();
     });
-    connect(chatPager.get(), &ChatPager::scrollToValueAdjustmentRequested, this, [this](int value) {
-        QScrollBar *sb = ui->textEditChat->verticalScrollBar();
-        if (sb)
-            sb->setValue(value);
+
+    connect(ui->tabWidget, &QTabWidget::currentChanged, this, &MainWindow::markVisibleRowsRead);
+
+    lastReadSaveDebounceTimer.setInterval(2000);
+    lastReadSaveDebounceTimer.setSingleShot(true);
+    connect(&lastReadSaveDebounceTimer, &QTimer::timeout, this, [this]() { settingsManager->saveLastReadId(lastReadId); });
+
+    connect(chatPager.get(), &ChatPager::seekResolved, this, [this](qint64 messageId) {
+        if (messageId == 0) {
+            ui->chatView->scrollToBottom(); // nothing that late; show the newest
+            return;
+        }
+
+        const int row = chatModel->rowForId(messageId);
+        if (row >= 0)
+            ui->chatView->scrollTo(chatModel->index(row), QAbstractItemView::PositionAtTop);
     });
 
 } //connectSignals
@@ -439,24 +559,109 @@ void MainWindow::loadInitialState()
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
-    settingsManager->load(configSettings);
+    // A small file read; everything below depends on it.
+    configSettings = settingsFuture.result();
     restoreGeometry(settingsManager->loadGeometry());
 
-    loadQStyleSheetFolder();
+    // Bound what the chat keeps in memory; trimmed history is paged back in from storage.
+    chatPager->setResidentMessageLimit(configSettings.maxLiveMessages);
+    chatDelegate->setDocumentLimit(qMin(configSettings.maxLiveMessages, ChatMessageDelegate::kMaxCachedDocuments));
 
-#ifdef ENABLE_DEMO_MODE
-    if (!styleRotator) {
-        styleRotator = new StyleRotator(ui->comboBoxSelectStyleSheet, QStyleSheetMap, this);
-    }
-#endif
+    // Nothing saved yet means a first start: the existing history counts as read.
+    lastReadId = settingsManager->loadLastReadId();
+    if (lastReadId < 0 || lastReadId > chatPager->lastId())
+        lastReadId = chatPager->lastId();
+    chatModel->setLastReadMarker(lastReadId);
+    updateUnreadCount();
 
-    setStyleSheet();
     setBackgroundImage();
     setAppWindowTitle();
-    fillNetworkWidgets();
     updateUIWidgets();
+    applyBackgroundLoads();
 } //loadInitialState
 
+void MainWindow::startBackgroundLoads()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    // Only plain file and system reads run here; every widget is touched on the GUI thread.
+    const SettingsManager *settings = settingsManager;
+    const QString styleFolder = QApplication::applicationDirPath() + "/../QStyleSheets";
+    const QString styleCatalogue = QApplication::applicationDirPath() + "/stylesheet_catalogue.ini";
+
+    settingsFuture = QtConcurrent::run([settings]() {
+        QElapsedTimer timer;
+        timer.start();
+        Settings loaded;
+        settings->load(loaded);
+        qInfo() << "[MainWindow] Startup worker: settings" << timer.elapsed() << "ms";
+        return loaded;
+    });
+
+    styleCatalogueFuture = QtConcurrent::run([styleFolder, styleCatalogue]() {
+        QElapsedTimer timer;
+        timer.start();
+        const QMap<QString, QString> styleSheets = StyleManager::loadCatalogue(styleFolder, styleCatalogue);
+        qInfo() << "[MainWindow] Startup worker: stylesheets" << timer.elapsed() << "ms";
+        return styleSheets;
+    });
+
+    networkAddressesFuture = QtConcurrent::run([]() {
+        QElapsedTimer timer;
+        timer.start();
+        const QList<QHostAddress> addresses = QNetworkInterface::allAddresses();
+        qInfo() << "[MainWindow] Startup worker: network interfaces" << timer.elapsed() << "ms";
+        return addresses;
+    });
+} //startBackgroundLoads
+
+void MainWindow::applyBackgroundLoads()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    // Either continuation may run right here if its worker is already done, or
+    // later from the event loop; both only need the settings, which are loaded.
+    styleCatalogueFuture.then(this, [this](const QMap<QString, QString> &styleSheets) {
+        setStyleSheetMap(styleSheets);
+
+#ifdef ENABLE_DEMO_MODE
+        if (!styleRotator) {
+            styleRotator = new StyleRotator(ui->comboBoxSelectStyleSheet, QStyleSheetMap, this);
+        }
+#endif
+
+        setStyleSheet();
+    });
+
+    networkAddressesFuture.then(this, [this](const QList<QHostAddress> &addresses) {
+        fillNetworkWidgets(addresses);
+    });
+} //applyBackgroundLoads
+
+void MainWindow::beginStartupStage(const QString &nextStage)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    const qint64 now = startupTimer.elapsed();
+    if (!startupStageTimes.isEmpty())
+        startupStageTimes.last().second = now - startupStageStartMs;
+
+    startupStageStartMs = now;
+    if (!nextStage.isEmpty())
+        startupStageTimes.append({nextStage, 0});
+
+    // The last call only closes the previous stage, so it reports 100%.
+    const int percent = 100 * startupStagesDone / (kStartupStages - 1);
+    ++startupStagesDone;
+
+    // showMessage() repaints the splash right away; the event loop is not running yet.
+    if (startupSplash) {
+        startupSplash->showMessage(QString("%1 (%2%)").arg(nextStage.isEmpty() ? tr("Ready") : nextStage).arg(percent),
+                                   Qt::AlignBottom | Qt::AlignHCenter,
+                                   Qt::white);
+    }
+} //beginStartupStage
+
 void MainWindow::initializeDatabase()
 {
     LOG_DEBUG(Q_FUNC_INFO);
@@ -466,19 +671,34 @@ void MainWindow::initializeDatabase()
         return;
     }
 
-    const QList<Message> messages = messageStore->fetchLastMessages(chatPager->messagesPerPage());
+    m_formatter->setUserDirectory(&messageStore->users());
 
-    chatPager->loadPage(messageStore->messageCount());
+    // Only the id bounds are read here. The view requests the pages it paints,
+    // which are read on the pool while the rest of the window is set up.
+    chatPager->reload();
 
-    displayMessages(messages);
+    if (chatPager->lastId() == 0)
+        isFirstPaintPending = true; // no page will load; the empty view is the first paint
 } //initializeDatabase
 
-MainWindow::MainWindow(QWidget *parent)
+void MainWindow::finishStartup()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    qInfo() << "[MainWindow] First page painted" << startupTimer.elapsed() << "ms after startup";
+    ui->statusbar->showMessage(tr("History ready in %1 ms").arg(startupTimer.elapsed()), 5000);
+
+    const int firstRow = qMax(0, ui->chatView->firstVisibleRow());
+    chatPager->prefetchOlderPages(chatModel->idForRow(firstRow), kStartupPrefetchPages);
+} //finishStartup
+
+MainWindow::MainWindow(QSplashScreen *splash, QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
+    startupTimer.start();
     ui->setupUi(this);
 
 
@@ -490,15 +710,32 @@ MainWindow::MainWindow(QWidget *parent)
 
 
     isApplicationStarting = true;
+    startupSplash = splash;
 
-    styleManager = std::make_unique<StyleManager>();
+    styleManager = std::make_unique<StyleManager>(this);
 
+    // The instance id names every per-instance file, so it comes first.
+    beginStartupStage(tr("Reserving instance"));
     initializeManagers();
+
+    beginStartupStage(tr("Setting up the window"));
+    startBackgroundLoads();
     initializeUi();
     connectSignals();
-    loadInitialState();
+    updateChatTheme(); // later stylesheet switches report themselves through ChatView::paletteChanged
+
+    beginStartupStage(tr("Opening chat history"));
     initializeDatabase();
 
+    beginStartupStage(tr("Applying settings"));
+    loadInitialState();
+
+    beginStartupStage(QString());
+    for (const auto &stage : std::as_const(startupStageTimes))
+        qInfo() << "[MainWindow] Startup stage" << stage.first << stage.second << "ms";
+    qInfo() << "[MainWindow] Window ready" << startupTimer.elapsed() << "ms after startup";
+    startupSplash = nullptr;
+
     userNameSaveDebounceTimer.setInterval(500);
     userNameSaveDebounceTimer.setSingleShot(true);
     connect(&userNameSaveDebounceTimer, &QTimer::timeout, this, [this]() { settingsManager->save(configSettings); });
@@ -515,8 +752,28 @@ MainWindow::~MainWindow()
         on_pushButtonStartStopDemo_clicked();
 #endif
 
+    if (chatPager) {
+        const ChatPager::PrefetchStats &stats = chatPager->prefetchStats();
+        qInfo() << "[MainWindow] Prefetched pages:" << stats.requested << "hits:" << stats.hits << "wasted:" << stats.wasted;
+    }
+
+    // Stop a running import or export before the history it works on is closed.
+    if (historyTransfer) {
+        historyTransfer->cancel();
+        historyTransferFuture.waitForFinished();
+    }
+
+    // Store what arrived since the last frame while the store is still alive.
+    // Only storage: the view, notifications and read state are being torn down.
+    if (incomingQueue) {
+        const QSignalBlocker blocker(incomingQueue);
+        incomingQueue->flush();
+    }
+
     if (settingsManager) {
         userNameSaveDebounceTimer.stop();
+        lastReadSaveDebounceTimer.stop();
+        settingsManager->saveLastReadId(lastReadId);
         settingsManager->save(configSettings);
         settingsManager->saveGeometry(saveGeometry());
     }
@@ -546,8 +803,19 @@ void MainWindow::storeAndDisplaySentMessage(const QString &user, const QString &
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
-    messageStore->insertMessage(user, msg, timestamp, true);
-    m_formatter->appendMessage(ui->textEditChat, user, msg, timestamp, true);
+    // Keep arrival order: anything received before this message is stored first.
+    incomingQueue->flush();
+
+    const qint64 sentId = messageStore->insertMessage(user, msg, timestamp, true);
+    chatPager->refreshTail();
+
+    // Our own message is read by definition, and so is everything we replied to.
+    if (sentId > lastReadId) {
+        lastReadId = sentId;
+        lastReadSaveDebounceTimer.start();
+    }
+    markVisibleRowsRead();
+    updateUnreadCount();
 } //storeAndDisplaySentMessage
 
 void MainWindow::on_pushButtonSend_clicked()
@@ -774,23 +1042,13 @@ void MainWindow::on_comboBoxSelectStyleSheet_currentTextChanged(const QString &s
 #endif
 } //on_comboBoxSelectStyleSheet_currentTextChanged
 
-void MainWindow::populateStyleSheetMap(const QString &folderPath)
-{
-    LOG_DEBUG(Q_FUNC_INFO);
-
-    QDirIterator it(folderPath, QStringList() << "*.qss", QDir::Files, QDirIterator::Subdirectories);
-    while (it.hasNext()) {
-        QFileInfo fileInfo(it.next());
-        QStyleSheetMap.insert(fileInfo.baseName(), fileInfo.absoluteFilePath());
-    }
-} //populateStyleSheetMap
-
 void MainWindow::populateStyleSheetComboBox()
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
-    ui->comboBoxSelectStyleSheet->clear();
+    // The catalogue may arrive after startup; clearing must not count as picking no stylesheet.
     QSignalBlocker block(ui->comboBoxSelectStyleSheet);
+    ui->comboBoxSelectStyleSheet->clear();
     ui->comboBoxSelectStyleSheet->addItem(""); // for 'none' or default
     ui->comboBoxSelectStyleSheet->addItems(QStyleSheetMap.keys());
 } //populateStyleSheetComboBox
@@ -806,24 +1064,31 @@ void MainWindow::on_checkBoxLoadStyleSheet_clicked(bool checked)
     SettingsManager::update(configSettings.b_loadStyleSheet, checked);
 } //on_checkBoxLoadStyleSheet_clicked
 
-void MainWindow::loadQStyleSheetFolder()
+void MainWindow::setStyleSheetMap(const QMap<QString, QString> &styleSheets)
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
-    const QString styleFolder = QApplication::applicationDirPath() + "/../QStyleSheets";
-    QStyleSheetMap.clear(); // clear existing entries
-
-    populateStyleSheetMap(styleFolder);
+    QStyleSheetMap = styleSheets;
     populateStyleSheetComboBox();
     styleManager->setStyleSheetMap(QStyleSheetMap);
-} //loadQStyleSheetFolder
+} //setStyleSheetMap
+
+void MainWindow::updateChatTheme()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    // Light text means a dark theme.
+    chatDelegate->setDarkTheme(ui->chatView->palette().color(QPalette::Text).lightness() > 127);
+    ui->chatView->viewport()->update();
+} //updateChatTheme
 
 void MainWindow::redrawCurrentMessages()
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
-    const QList<Message> messages = messageStore->fetchMessages(chatPager->visibleOffset(), chatPager->visibleLimit());
-    displayMessages(messages);
+    // Nothing is re-read or re-formatted: cached documents take the new font and
+    // theme formats in place while the rows are measured again.
+    ui->chatView->invalidateRowHeights();
 } //redrawCurrentMessages
 
 void MainWindow::on_checkBoxDisplayBackgroundImage_clicked(bool checked)
@@ -879,6 +1144,29 @@ void MainWindow::on_pushButtonTestMsg_clicked()
     ui->lineEditChatText->setText(generateNextTestMessage());
 } //on_pushButtonTestMsg_clicked
 
+void MainWindow::on_pushButtonJumpToDate_clicked()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    if (chatPager)
+        chatPager->seekToTime(ui->dateTimeEditJumpToDate->dateTime());
+} //on_pushButtonJumpToDate_clicked
+
+void MainWindow::on_pushButtonJumpToUnread_clicked()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    // Rows are ids, so the first unread message is addressed directly; only its page is read.
+    // The next id may be pruned or, in the shared layout, not linked to this instance.
+    const qint64 firstUnreadId = chatPager->store()->firstMessageIdAfter(lastReadId);
+    const int row = firstUnreadId > 0 ? chatModel->rowForId(firstUnreadId) : -1;
+
+    if (row >= 0)
+        ui->chatView->scrollTo(chatModel->index(row), QAbstractItemView::PositionAtTop);
+    else
+        ui->chatView->scrollToBottom();
+} //on_pushButtonJumpToUnread_clicked
+
 void MainWindow::on_pushButtonDeleteDatabase_clicked()
 {
     LOG_DEBUG(Q_FUNC_INFO);
@@ -892,7 +1180,7 @@ void MainWindow::on_pushButtonDeleteDatabase_clicked()
         return;
 
     if (messageStore->clearMessages()) {
-        ui->textEditChat->clear();
+        chatPager->reload();
 
         ui->labelStatus->setText(tr("Chat history cleared."));
     } else {
@@ -900,11 +1188,113 @@ void MainWindow::on_pushButtonDeleteDatabase_clicked()
     }
 } //on_pushButtonDeleteDatabase_clicked
 
+void MainWindow::runHistoryTransfer(bool isImport, const QString &path)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    if (historyTransfer)
+        return;
+
+    const HistoryTransfer::Format format = HistoryTransfer::formatForPath(path);
+    historyTransfer = std::make_shared<HistoryTransfer>(messageStore);
+
+    MessageStore *store = dynamic_cast<MessageStore *>(messageStore);
+    if (!store) {
+        // Single-writer backend: nothing may touch the store until the transfer is done.
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        const bool ok = isImport ? historyTransfer->importFrom(path, format) : historyTransfer->exportTo(path, format);
+        QApplication::restoreOverrideCursor();
+        finishHistoryTransfer(isImport, ok);
+        return;
+    }
+
+    auto *progress = new QProgressDialog(isImport ? tr("Importing chat history...") : tr("Exporting chat history..."), tr("Cancel"), 0, 1000, this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(250);
+    progress->setValue(0);
+
+    connect(progress, &QProgressDialog::canceled, historyTransfer.get(), &HistoryTransfer::cancel);
+    connect(historyTransfer.get(), &HistoryTransfer::progressChanged, progress, [progress](qint64 done, qint64 total) {
+        if (total > 0)
+            progress->setValue(static_cast<int>(done * 1000 / total));
+    }, Qt::QueuedConnection); // emitted on the worker
+
+    ui->actionImport_History->setEnabled(false);
+    ui->actionExport_History->setEnabled(false);
+
+    historyTransferFuture = QtConcurrent::run([store, transfer = historyTransfer, isImport, path, format]() {
+        // The connection must be opened, used and closed on this thread.
+        const std::unique_ptr<MessageStore> handle = store->openWorkerHandle();
+        transfer->setStore(handle.get());
+        const bool ok = isImport ? transfer->importFrom(path, format) : transfer->exportTo(path, format);
+        transfer->setStore(nullptr);
+        return ok;
+    });
+
+    historyTransferFuture.then(this, [this, progress, isImport](bool ok) {
+        progress->deleteLater();
+        finishHistoryTransfer(isImport, ok);
+    });
+} //runHistoryTransfer
+
+void MainWindow::finishHistoryTransfer(bool isImport, bool ok)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    const std::shared_ptr<HistoryTransfer> transfer = std::exchange(historyTransfer, nullptr);
+    ui->actionImport_History->setEnabled(true);
+    ui->actionExport_History->setEnabled(true);
+
+    if (isImport && transfer->processedCount() > 0) {
+        if (auto *store = dynamic_cast<MessageStore *>(messageStore))
+            store->refresh(); // rows were written through another connection
+        chatPager->reload();
+    }
+
+    if (ok) {
+        // Imported rows are appended, so they follow the existing history whatever their timestamps.
+        ui->labelStatus->setText(isImport ? tr("Imported %1 messages after the existing history.").arg(transfer->processedCount())
+                                          : tr("Exported %1 messages.").arg(transfer->processedCount()));
+    } else if (transfer->wasCancelled()) {
+        ui->labelStatus->setText(transfer->lastError());
+    } else {
+        QMessageBox::warning(this, tr("Error"), transfer->lastError());
+    }
+} //finishHistoryTransfer
+
+void MainWindow::on_actionExport_History_triggered()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    const QString path = QFileDialog::getSaveFileName(this,
+                                                      tr("Export Chat History"),
+                                                      QCoreApplication::applicationDirPath(),
+                                                      tr("Chester history (*.chb);;NDJSON (*.ndjson *.jsonl)"));
+    if (!path.isEmpty())
+        runHistoryTransfer(false, path);
+} //on_actionExport_History_triggered
+
+void MainWindow::on_actionImport_History_triggered()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    const QString path = QFileDialog::getOpenFileName(this,
+                                                      tr("Import Chat History"),
+                                                      QCoreApplication::applicationDirPath(),
+                                                      tr("Chat history (*.chb *.ndjson *.jsonl);;All files (*)"));
+    if (!path.isEmpty())
+        runHistoryTransfer(true, path);
+} //on_actionImport_History_triggered
+
 #ifdef ENABLE_DEMO_MODE
 void MainWindow::stopDemoModeUiReset()
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
+    // Switch back before the demo store is deleted with the simulator.
+    m_formatter->setUserDirectory(&messageStore->users());
+    chatPager->setStore(messageStore);
+
     if (demoSimulator) {
         demoSimulator->stopDemo();
         demoSimulator.reset(); // delete and nullify
@@ -928,9 +1318,6 @@ void MainWindow::stopDemoModeUiReset()
 
     isDemoRunning = false;
 
-    const QList<Message> messages = messageStore->fetchLastMessages(chatPager->messagesPerPage());
-    chatPager->loadPage(messageStore->messageCount() - messages.size());
-
     ui->pushButtonConnect->setEnabled(true);
     ui->frameUDPParameters->setEnabled(true);
     ui->frameChatSend->setEnabled(true);
@@ -943,8 +1330,6 @@ void MainWindow::startDemoModeUiSetup()
 
     isDemoRunning = true;
 
-    ui->textEditChat->clear();
-
     styleRotator->start();
 
     ui->pushButtonStartStopDemo->setText("Stop Demo Mode");
@@ -956,8 +1341,6 @@ void MainWindow::startDemoModeUiSetup()
 
     ui->tabWidget->setTabEnabled(0, true);
     ui->tabWidget->setCurrentIndex(0);
-    // chatPager->loadPage(messageStore->messageCount());
-
 } //startDemoModeUiSetup
 
 void MainWindow::on_pushButtonStartStopDemo_clicked()
@@ -978,14 +1361,9 @@ void MainWindow::on_pushButtonStartStopDemo_clicked()
         }
 
         // Always create a new simulator for fresh state
-        demoSimulator.reset(new DemoChatSimulator(ui->textEditChat, m_formatter, this));
+        demoSimulator.reset(new DemoChatSimulator(instanceID, this));
 
-        connect(demoSimulator.get(), &DemoChatSimulator::signalRequestClearChatDisplay, this, [this]() {
-            QTimer::singleShot(0, this, [this]() {
-                if (ui && ui->textEditChat)
-                    ui->textEditChat->clear(); // Safe on main thread
-            });
-        });
+        connect(demoSimulator.get(), &DemoChatSimulator::signalMessageStored, this, [this]() { chatPager->refreshTail(); });
 
         if (!demoSimulator->startDemo()) {
             demoSimulator.reset(); // destroy faulty instance
@@ -993,6 +1371,10 @@ void MainWindow::on_pushButtonStartStopDemo_clicked()
             return;
         }
 
+        // The demo plays in its own store; the real history stays untouched.
+        m_formatter->setUserDirectory(&demoSimulator->store()->users());
+        chatPager->setStore(demoSimulator->store());
+
         startDemoModeUiSetup();
 
     } else {
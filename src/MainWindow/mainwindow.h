@@ -22,7 +22,7 @@
 #include "../globals.h"
 
 #include "../ChatFormatter/chatformatter.h"
-#include "../MessageStore/messagestore.h"
+#include "../MessageStorage/messagestorage.h"
 #include "../SettingsManager/settingsmanager.h"
 #include "../UDPChatSocketManager/udpchatsocketmanager.h"
 #include "../StyleRotator/stylerotator.h"
@@ -30,6 +30,9 @@
 #include "../InstanceIdManager/instanceidmanager.h"
 
 #include "../ChatPager/chatpager.h"
+#include "../IncomingMessageQueue/incomingmessagequeue.h"
+#include "../ChatMessageModel/chatmessagemodel.h"
+#include "../ChatMessageDelegate/chatmessagedelegate.h"
 
 #include <QScrollBar>
 #include <QWheelEvent>
@@ -38,6 +41,10 @@
 #include <QDesktopServices>
 #include <QNetworkInterface>
 #include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QImage>
+#include <QSplashScreen>
 
 #ifdef ENABLE_DEMO_MODE
 #include "../DemoChatSimulator/demochatsimulator.h"
@@ -49,6 +56,8 @@ class MainWindow;
 }
 QT_END_NAMESPACE
 
+class HistoryTransfer;
+
 /**
  * @class MainWindow
  * @brief Main application window for Chester The Chat.
@@ -63,9 +72,15 @@ class MainWindow : public QMainWindow
 public:
     /**
      * @brief Constructs the main window.
+     *
+     * Stages that do not depend on each other run concurrently: settings, the
+     * stylesheet folder and the network interfaces are read on worker threads
+     * while the GUI thread sets up the widgets and opens the chat history.
+     *
+     * @param splash Optional splash screen showing the startup stage; only used during construction.
      * @param parent Optional parent widget.
      */
-    explicit MainWindow(QWidget *parent = nullptr);
+    explicit MainWindow(QSplashScreen *splash = nullptr, QWidget *parent = nullptr);
 
     /**
      * @brief Tears down the main window, saving settings and releasing resources.
@@ -74,13 +89,22 @@ public:
 
 protected:
     /**
-     * @brief Filters events to implement custom scroll handling in the chat view.
+     * @brief Filters events to detect the first paint of the chat view.
      * @param obj The object receiving the event.
      * @param event The event being processed.
      * @return True if the event was handled here; otherwise false.
      */
     bool eventFilter(QObject *obj, QEvent *event) override;
 
+    /**
+     * @brief Tracks window activation for the last read marker.
+     *
+     * Rows on screen count as read once the window is active again; when it is
+     * left, the marker moves to the last read message so everything arriving
+     * meanwhile shows up below it.
+     */
+    void changeEvent(QEvent *event) override;
+
 private:
     /// Manages dynamic application stylesheets.
     std::unique_ptr<StyleManager> styleManager;
@@ -88,7 +112,7 @@ private:
     /// Ensures unique per-process instance ID persistence.
     std::unique_ptr<InstanceIdManager> instanceIdManager;
 
-    /// Handles paginated chat history loading and scroll-based navigation.
+    /// Loads chat history pages on demand for the chat view.
     std::unique_ptr<ChatPager> chatPager;
 
     /// UI form generated by Qt Designer.
@@ -121,7 +145,9 @@ private:
      */
     ///@{
     ChatFormatter   *m_formatter      = nullptr; ///< Formats messages for display.
-    MessageStore    *messageStore     = nullptr; ///< Persists chat history.
+    MessageStorage  *messageStore     = nullptr; ///< Persists chat history.
+    ChatMessageModel    *chatModel    = nullptr; ///< Exposes the history to the chat view.
+    ChatMessageDelegate *chatDelegate = nullptr; ///< Paints chat view rows.
     ///@}
 
     /** @name UDP Communication
@@ -129,6 +155,7 @@ private:
      */
     ///@{
     UdpChatSocketManager *udpManager  = nullptr; ///< Manages UDP sockets.
+    IncomingMessageQueue *incomingQueue = nullptr; ///< Stores received messages once per frame.
     ///@}
 
     /** @name Application Configuration
@@ -139,7 +166,31 @@ private:
     SettingsManager *settingsManager = nullptr; ///< Persists Settings to disk.
     int              instanceID      = 0;       ///< Unique ID for this app instance.
     bool             isApplicationStarting = false; ///< Flag suppressing signals during init.
+    QElapsedTimer    startupTimer;               ///< Runs from construction to the first painted page.
+    bool             isFirstPaintPending = false; ///< True once the first page is loaded but not yet painted.
+    bool             isStartupComplete = false;  ///< True after the first page has been painted.
+    QSplashScreen   *startupSplash = nullptr;    ///< Shows startup progress while constructing.
+    int              startupStagesDone = 0;      ///< Startup stages reported so far.
+    qint64           startupStageStartMs = 0;    ///< startupTimer value when the current stage began.
+    QList<QPair<QString, qint64>> startupStageTimes; ///< Duration of each finished startup stage in ms.
     QMap<QString, QString> QStyleSheetMap;      ///< Maps display names to .qss file paths.
+    QImage           chatBackgroundImage;       ///< Chat background, decoded on first use.
+    ///@}
+
+    /** @name Read State
+     *  How far the user has read the chat history.
+     */
+    ///@{
+    qint64 lastReadId = 0;            ///< Newest message id seen on screen while the window was active.
+    QTimer lastReadSaveDebounceTimer; ///< Debounces saving lastReadId.
+    ///@}
+
+    /** @name History Transfer
+     *  Import or export running on a worker thread.
+     */
+    ///@{
+    std::shared_ptr<HistoryTransfer> historyTransfer; ///< The running transfer, or null.
+    QFuture<bool> historyTransferFuture;              ///< Finishes with the result of historyTransfer.
     ///@}
 
 #ifdef EXPIRES
@@ -171,25 +222,44 @@ private:
     void initializeDatabase();    ///< Opens message DB and loads initial messages.
     void connectSignals();        ///< Connects internal signals and slots.
     void loadInitialState();      ///< Applies saved settings and loads UI state.
+    void finishStartup();         ///< Reports time to first paint and warms older history.
+    void startBackgroundLoads();  ///< Starts the startup stages that run on worker threads.
+    void applyBackgroundLoads();  ///< Applies the worker stages' results as each one finishes.
+
+    /**
+     * @brief Ends the current startup stage and begins @p nextStage.
+     *
+     * Records how long the finished stage took and shows @p nextStage with the
+     * share of stages done on the splash screen.
+     */
+    void beginStartupStage(const QString &nextStage);
     ///@}
 
-    /** @name UI Population and Sync
-     *  Methods to populate and refresh UI controls.
+    /// Number of beginStartupStage() calls during construction, for the progress shown.
+    static constexpr int kStartupStages = 5;
+
+    /** @name Background Startup
+     *  Startup stages run on worker threads. Only the settings are waited for;
+     *  the others are applied once the window is up.
      */
     ///@{
-    void fillNetworkWidgets();    ///< Lists valid IPv4 interfaces in network combo box.
-    void updateUIWidgets();       ///< Syncs widget values from current Settings.
+    QFuture<Settings> settingsFuture;                     ///< Settings read from the instance file.
+    QFuture<QMap<QString, QString>> styleCatalogueFuture; ///< Stylesheet names and paths.
+    QFuture<QList<QHostAddress>> networkAddressesFuture;  ///< Addresses of the local network interfaces.
     ///@}
 
-    /** @name Chat Display
-     *  Renders chat history into the UI.
+    /// Older pages fetched into the cache once the first page is on screen.
+    static constexpr int kStartupPrefetchPages = 2;
+
+    /** @name UI Population and Sync
+     *  Methods to populate and refresh UI controls.
      */
     ///@{
-    /**
-     * @brief Renders a batch of messages into the chat view.
-     * @param messages List of Message objects to display.
-     */
-    void displayMessages(const QList<Message> &messages);
+    void fillNetworkWidgets(const QList<QHostAddress> &addresses); ///< Lists valid IPv4 addresses in network combo box.
+    void updateUIWidgets();       ///< Syncs widget values from current Settings.
+    void prelayoutChatRows();     ///< Lays out rows around the screen on the delegate's pool.
+    void markVisibleRowsRead();   ///< Advances lastReadId to the rows on screen.
+    void updateUnreadCount();     ///< Shows the number of messages after lastReadId.
     ///@}
 
     /** @name Style & Appearance
@@ -198,10 +268,8 @@ private:
     ///@{
     void setStyleSheet();         ///< Applies selected .qss if enabled.
     void setBackgroundImage();    ///< Toggles background graphic in chat.
-    void loadQStyleSheetFolder(); ///< Scans directory for .qss files.
-    void populateStyleSheetMap(const QString &folderPath);     ///< Fills QStyleSheetMap.
+    void setStyleSheetMap(const QMap<QString, QString> &styleSheets); ///< Publishes scanned .qss files to the UI and StyleManager.
     void populateStyleSheetComboBox();                        ///< Populates UI combo box.
-    QString chatBackgroundStyle() const; ///< Returns CSS snippet for chat background.
     ///@}
 
     /** @name Application Metadata
@@ -248,10 +316,34 @@ private:
     ///@}
 
     /**
-     * @brief Re-renders currently visible messages, used after theme changes.
+     * @brief Re-applies the theme to the visible messages, used after theme changes.
      */
     void redrawCurrentMessages();
 
+    /**
+     * @brief Picks the light or dark message formats from the chat view's palette.
+     */
+    void updateChatTheme();
+
+    /**
+     * @brief Starts an import or export on a worker thread with a cancellable progress dialog.
+     *
+     * The worker uses its own database connection, so incoming messages are
+     * stored and pages read meanwhile. Backends with a single writer run the
+     * transfer on this thread instead, without processing events.
+     *
+     * @param isImport True to import from @p path, false to export to it.
+     * @param path The history file.
+     */
+    void runHistoryTransfer(bool isImport, const QString &path);
+
+    /**
+     * @brief Reloads the view after an import and reports the transfer's outcome.
+     * @param isImport True if the finished transfer was an import.
+     * @param ok Result of the transfer.
+     */
+    void finishHistoryTransfer(bool isImport, bool ok);
+
 #ifdef ENABLE_DEMO_MODE
     /**
      * @brief Configures UI for entering demo mode.
@@ -278,6 +370,8 @@ private slots:
     void on_pushButtonSend_clicked();      ///< Sends chat text on Send button.
     void on_lineEditChatText_returnPressed(); ///< Sends on <Enter> in text field.
     void on_pushButtonTestMsg_clicked();   ///< Inserts a test message into input.
+    void on_pushButtonJumpToDate_clicked(); ///< Seeks the chat view to the picked date and time.
+    void on_pushButtonJumpToUnread_clicked(); ///< Shows the first unread message.
     ///@}
 
     /** @name Connection Control Slots */
@@ -312,6 +406,8 @@ private slots:
     /** @name Database Management Slots */
     ///@{
     void on_pushButtonDeleteDatabase_clicked(); ///< Clears chat history on confirmation.
+    void on_actionExport_History_triggered();   ///< Streams chat history to a file.
+    void on_actionImport_History_triggered();   ///< Streams chat history from a file.
     ///@}
 
 #ifdef ENABLE_DEMO_MODE
@@ -0,0 +1,98 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "messagebatch.h"
+
+#include "../UserDirectory/userdirectory.h"
+
+#include <QTimeZone>
+
+#include <algorithm>
+
+void MessageBatch::reserve(int rows, qsizetype textUnits)
+{
+    m_rows.reserve(rows);
+    if (textUnits > 0)
+        m_text.reserve(textUnits);
+} //reserve
+
+void MessageBatch::append(qint64 id, int userId, QStringView text, qint64 msecs, quint8 flags)
+{
+    Row row;
+    row.id = id;
+    row.msecs = msecs;
+    row.userId = userId;
+    row.textOffset = quint32(m_text.size());
+    row.textLength = quint32(text.size());
+    row.flags = flags;
+
+    m_text.append(text);
+    m_rows.append(row);
+} //append
+
+void MessageBatch::append(const Message &message)
+{
+    append(message.id,
+           message.userId,
+           message.text,
+           message.timestamp.toMSecsSinceEpoch(),
+           message.isSentByMe ? SentByMe : 0);
+} //append
+
+QDateTime MessageBatch::timestamp(int i) const
+{
+    return QDateTime::fromMSecsSinceEpoch(m_rows.at(i).msecs, QTimeZone::UTC);
+} //timestamp
+
+QStringView MessageBatch::text(int i) const
+{
+    const Row &row = m_rows.at(i);
+    return QStringView(m_text).mid(row.textOffset, row.textLength);
+} //text
+
+int MessageBatch::indexOf(qint64 id) const
+{
+    if (m_rows.isEmpty() || id < firstId() || id > lastId())
+        return -1;
+
+    const qint64 guess = id - firstId();
+    if (guess < m_rows.size() && m_rows.at(int(guess)).id == id)
+        return int(guess);
+
+    auto it = std::lower_bound(m_rows.cbegin(), m_rows.cend(), id, [](const Row &row, qint64 value) {
+        return row.id < value;
+    });
+    return (it != m_rows.cend() && it->id == id) ? int(it - m_rows.cbegin()) : -1;
+} //indexOf
+
+Message MessageBatch::message(int i, const UserDirectory &users) const
+{
+    Message m;
+    m.id = id(i);
+    m.userId = userId(i);
+    m.user = users.name(m.userId);
+    m.text = text(i).toString();
+    m.timestamp = timestamp(i);
+    m.isSentByMe = isSentByMe(i);
+    return m;
+} //message
+
+qsizetype MessageBatch::memoryUsage() const
+{
+    return m_rows.capacity() * qsizetype(sizeof(Row)) + m_text.capacity() * qsizetype(sizeof(QChar));
+} //memoryUsage
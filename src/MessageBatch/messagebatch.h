@@ -0,0 +1,149 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MESSAGEBATCH_H
+#define MESSAGEBATCH_H
+
+#include "structures.h"
+
+#include <QDateTime>
+#include <QMetaType>
+#include <QString>
+#include <QStringView>
+#include <QVector>
+
+#include <memory>
+
+class UserDirectory;
+
+/**
+ * @class MessageBatch
+ * @brief Compact, read-mostly block of consecutive chat messages.
+ *
+ * A page of history is stored as fixed-size rows plus one text arena: every
+ * message text is appended to a single QString and rows refer to it by offset
+ * and length. Senders are kept as interned user ids, timestamps as UTC
+ * milliseconds and the boolean attributes as bits of one flags byte. A page of
+ * N messages therefore costs two allocations instead of roughly 3N for a
+ * QList<Message>.
+ *
+ * Batches are built once by a storage backend and then shared immutably through
+ * MessageBatchPtr, so the page cache, the pager's signal and the renderer all
+ * refer to the same memory.
+ */
+class MessageBatch {
+public:
+    /**
+     * @brief Bits of Row::flags.
+     */
+    enum Flag : quint8 {
+        SentByMe = 0x01 ///< Sent by the local user.
+    };
+
+    /**
+     * @struct Row
+     * @brief Fixed-size description of one message.
+     */
+    struct Row {
+        qint64  id = 0;         ///< Message id.
+        qint64  msecs = 0;      ///< Timestamp in milliseconds since the epoch, UTC.
+        qint32  userId = 0;     ///< Interned sender id.
+        quint32 textOffset = 0; ///< Offset of the text in the arena, in UTF-16 units.
+        quint32 textLength = 0; ///< Length of the text, in UTF-16 units.
+        quint8  flags = 0;      ///< Combination of Flag bits.
+    };
+
+    /**
+     * @brief Reserves room for @p rows messages and @p textUnits UTF-16 units of text.
+     */
+    void reserve(int rows, qsizetype textUnits = 0);
+
+    /**
+     * @brief Appends one message; rows must be appended in ascending id order.
+     */
+    void append(qint64 id, int userId, QStringView text, qint64 msecs, quint8 flags);
+
+    /**
+     * @brief Appends a Message value.
+     */
+    void append(const Message &message);
+
+    /// Returns the number of messages.
+    int size() const { return m_rows.size(); }
+
+    /// Returns true if the batch holds no messages.
+    bool isEmpty() const { return m_rows.isEmpty(); }
+
+    /// Returns row @p i.
+    const Row &row(int i) const { return m_rows.at(i); }
+
+    /// Returns the id of message @p i.
+    qint64 id(int i) const { return m_rows.at(i).id; }
+
+    /// Returns the interned sender id of message @p i.
+    int userId(int i) const { return m_rows.at(i).userId; }
+
+    /// Returns the timestamp of message @p i in milliseconds since the epoch.
+    qint64 msecs(int i) const { return m_rows.at(i).msecs; }
+
+    /// Returns the UTC timestamp of message @p i.
+    QDateTime timestamp(int i) const;
+
+    /// Returns true if message @p i was sent by the local user.
+    bool isSentByMe(int i) const { return (m_rows.at(i).flags & SentByMe) != 0; }
+
+    /// Returns the text of message @p i as a view into the arena.
+    QStringView text(int i) const;
+
+    /// Returns the id of the first message, or 0 if empty.
+    qint64 firstId() const { return m_rows.isEmpty() ? 0 : m_rows.first().id; }
+
+    /// Returns the id of the last message, or 0 if empty.
+    qint64 lastId() const { return m_rows.isEmpty() ? 0 : m_rows.last().id; }
+
+    /**
+     * @brief Returns the index of the message with id @p id, or -1 if the batch does not hold it.
+     *
+     * Constant time when the batch's ids are contiguous, a binary search otherwise.
+     */
+    int indexOf(qint64 id) const;
+
+    /**
+     * @brief Materializes message @p i as a standalone Message.
+     * @param users Directory used to resolve the sender name.
+     */
+    Message message(int i, const UserDirectory &users) const;
+
+    /**
+     * @brief Returns the approximate heap footprint in bytes.
+     */
+    qsizetype memoryUsage() const;
+
+private:
+    QVector<Row> m_rows; /**< One entry per message. */
+    QString      m_text; /**< Arena holding every message text back to back. */
+};
+
+/**
+ * @brief Shared, immutable handle used to pass batches between components.
+ */
+using MessageBatchPtr = std::shared_ptr<const MessageBatch>;
+
+Q_DECLARE_METATYPE(MessageBatchPtr)
+
+#endif // MESSAGEBATCH_H
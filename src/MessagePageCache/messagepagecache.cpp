@@ -0,0 +1,174 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "messagepagecache.h"
+
+MessagePageCache::MessagePageCache(int maxMessages)
+    : m_blocks(maxMessages)
+    , m_ranges(maxMessages)
+{}
+
+bool MessagePageCache::count(bool hit)
+{
+    if (hit)
+        ++m_hits;
+    else
+        ++m_misses;
+    return hit;
+} //count
+
+MessagePageCache::Block *MessagePageCache::matchingBlock(const RangeKey &key, int limit)
+{
+    Block *block = m_blocks.object(key); // also marks the block as most recently used
+    if (!block)
+        return nullptr;
+
+    // A full block answers any request of the same size. A short block is only
+    // complete if it reached the newest message when it was fetched.
+    const bool sizeMatches = block->batch->size() == limit
+                             || (block->isTail && block->batch->size() < limit && block->limit == limit);
+    return sizeMatches ? block : nullptr;
+} //matchingBlock
+
+bool MessagePageCache::lookupRange(qint64 firstId, qint64 lastId, MessageBatchPtr &batch)
+{
+    Block *block = m_ranges.object(RangeKey(firstId, lastId));
+    if (block)
+        batch = block->batch;
+    return count(block != nullptr);
+} //lookupRange
+
+bool MessagePageCache::lookupStartingAt(qint64 firstId, int limit, MessageBatchPtr &batch)
+{
+    auto it = m_byFirstId.constFind(firstId);
+    if (it == m_byFirstId.constEnd())
+        return count(false);
+
+    Block *block = matchingBlock(it.value(), limit);
+    if (!block) {
+        if (!m_blocks.contains(it.value()))
+            m_byFirstId.erase(it);
+        return count(false);
+    }
+
+    batch = block->batch;
+    return count(true);
+} //lookupStartingAt
+
+bool MessagePageCache::lookupEndingAt(qint64 lastId, int limit, MessageBatchPtr &batch)
+{
+    auto it = m_byLastId.constFind(lastId);
+    if (it == m_byLastId.constEnd())
+        return count(false);
+
+    Block *block = m_blocks.object(it.value());
+    if (!block || block->batch->size() != limit) {
+        if (!block)
+            m_byLastId.erase(it);
+        return count(false);
+    }
+
+    batch = block->batch;
+    return count(true);
+} //lookupEndingAt
+
+bool MessagePageCache::lookupTail(int limit, MessageBatchPtr &batch)
+{
+    for (const RangeKey &key : std::as_const(m_tailKeys)) {
+        if (!m_blocks.contains(key))
+            continue;
+
+        Block *block = m_blocks.object(key);
+        if (block->batch->size() == limit) {
+            batch = block->batch;
+            return count(true);
+        }
+    }
+    return count(false);
+} //lookupTail
+
+void MessagePageCache::insert(const MessageBatchPtr &batch, int limit, bool isTail)
+{
+    if (!batch || batch->isEmpty())
+        return;
+
+    const RangeKey key(batch->firstId(), batch->lastId());
+
+    Block *block = new Block;
+    block->batch = batch;
+    block->limit = limit;
+    block->isTail = isTail;
+
+    // QCache takes ownership and deletes the block if it can never fit.
+    if (!m_blocks.insert(key, block, batch->size()))
+        return;
+
+    m_byFirstId.insert(key.first, key);
+    m_byLastId.insert(key.second, key);
+
+    if (isTail)
+        m_tailKeys.insert(key);
+} //insert
+
+void MessagePageCache::insertRange(qint64 firstId, qint64 lastId, const MessageBatchPtr &batch, bool isTail)
+{
+    if (!batch)
+        return;
+
+    Block *block = new Block;
+    block->batch = batch;
+    block->limit = -1;
+    block->isTail = isTail;
+
+    // Empty answers (ids held by other instances, pruned ids) are worth keeping too.
+    const RangeKey key(firstId, lastId);
+    if (!m_ranges.insert(key, block, qMax<qsizetype>(1, batch->size())))
+        return;
+
+    if (isTail)
+        m_tailRanges.insert(key);
+    else
+        m_tailRanges.remove(key);
+} //insertRange
+
+void MessagePageCache::invalidateTail()
+{
+    for (const RangeKey &key : std::as_const(m_tailKeys)) {
+        m_blocks.remove(key);
+        // A newer block may share an end id with this one and own the index entry.
+        if (m_byFirstId.value(key.first) == key)
+            m_byFirstId.remove(key.first);
+        if (m_byLastId.value(key.second) == key)
+            m_byLastId.remove(key.second);
+    }
+    m_tailKeys.clear();
+
+    for (const RangeKey &key : std::as_const(m_tailRanges))
+        m_ranges.remove(key);
+    m_tailRanges.clear();
+} //invalidateTail
+
+void MessagePageCache::clear()
+{
+    m_blocks.clear();
+    m_ranges.clear();
+    m_tailRanges.clear();
+    m_byFirstId.clear();
+    m_byLastId.clear();
+    m_tailKeys.clear();
+} //clear
@@ -0,0 +1,162 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MESSAGEPAGECACHE_H
+#define MESSAGEPAGECACHE_H
+
+#include "../MessageBatch/messagebatch.h"
+
+#include <QCache>
+#include <QHash>
+#include <QPair>
+#include <QSet>
+
+/**
+ * @class MessagePageCache
+ * @brief Bounded LRU cache of decoded message blocks keyed by id range.
+ *
+ * Each block holds the shared MessageBatch of one contiguous id range
+ * [firstId, lastId] as returned by a MessageStore query; a hit hands out
+ * another reference to it rather than a copy. Page blocks can be found by
+ * their first id (paging forward) or by their last id (paging back). Id range
+ * queries are cached under the range that was asked for, which may hold ids
+ * that do not exist at either end or none at all, and found by it again.
+ *
+ * Blocks that touch the newest message are flagged as tail blocks and are the
+ * only ones dropped when a new message is inserted; every other block covers a
+ * closed range whose content cannot change until the history is cleared or pruned.
+ */
+class MessagePageCache {
+public:
+    /**
+     * @brief Constructs an empty cache.
+     * @param maxMessages Upper bound on the number of cached messages, for pages and for id ranges each.
+     */
+    explicit MessagePageCache(int maxMessages = 1000);
+
+    /**
+     * @brief Looks up the answer to the id range query [firstId, lastId].
+     * @param firstId First id of the requested range.
+     * @param lastId Last id of the requested range.
+     * @param batch Receives the cached batch on a hit.
+     * @return True on a cache hit.
+     */
+    bool lookupRange(qint64 firstId, qint64 lastId, MessageBatchPtr &batch);
+
+    /**
+     * @brief Looks up a page of @p limit messages starting at @p firstId.
+     * @param firstId Id of the first message of the page.
+     * @param limit Requested page size.
+     * @param batch Receives the cached batch on a hit.
+     * @return True on a cache hit.
+     */
+    bool lookupStartingAt(qint64 firstId, int limit, MessageBatchPtr &batch);
+
+    /**
+     * @brief Looks up a page of @p limit messages ending at @p lastId.
+     * @param lastId Id of the last message of the page.
+     * @param limit Requested page size.
+     * @param batch Receives the cached batch on a hit.
+     * @return True on a cache hit.
+     */
+    bool lookupEndingAt(qint64 lastId, int limit, MessageBatchPtr &batch);
+
+    /**
+     * @brief Looks up the newest @p limit messages.
+     * @param limit Requested page size.
+     * @param batch Receives the cached batch on a hit.
+     * @return True on a cache hit.
+     */
+    bool lookupTail(int limit, MessageBatchPtr &batch);
+
+    /**
+     * @brief Stores a batch of messages in ascending id order.
+     * @param batch The decoded batch; empty batches are ignored.
+     * @param limit The page size the block was fetched with.
+     * @param isTail True if the block ends at the newest stored message.
+     */
+    void insert(const MessageBatchPtr &batch, int limit, bool isTail);
+
+    /**
+     * @brief Stores the answer to the id range query [firstId, lastId].
+     * @param firstId First id of the requested range.
+     * @param lastId Last id of the requested range.
+     * @param batch Every message with an id in the range, possibly none.
+     * @param isTail True if the range reaches the newest stored message.
+     */
+    void insertRange(qint64 firstId, qint64 lastId, const MessageBatchPtr &batch, bool isTail);
+
+    /**
+     * @brief Drops every tail block. Called after a message is inserted.
+     */
+    void invalidateTail();
+
+    /**
+     * @brief Drops every block. Called after the history is cleared or pruned.
+     */
+    void clear();
+
+    /// Returns the number of lookups served from the cache.
+    quint64 hits() const { return m_hits; }
+
+    /// Returns the number of lookups that had to go to the database.
+    quint64 misses() const { return m_misses; }
+
+    /// Resets the hit and miss counters.
+    void resetCounters() { m_hits = 0; m_misses = 0; }
+
+private:
+    /// Key identifying a block by its inclusive id range.
+    using RangeKey = QPair<qint64, qint64>;
+
+    /**
+     * @struct Block
+     * @brief A cached run of messages and the query shape it answers.
+     */
+    struct Block {
+        MessageBatchPtr batch;   ///< Messages in ascending id order.
+        int limit = 0;           ///< Page size the block was fetched with.
+        bool isTail = false;     ///< True if the block ends at the newest message.
+    };
+
+    /**
+     * @brief Returns the block for @p key if it still satisfies a page request.
+     * @param key Range of the candidate block.
+     * @param limit Requested page size.
+     * @return The block, or nullptr if evicted or sized for a different limit.
+     */
+    Block *matchingBlock(const RangeKey &key, int limit);
+
+    /**
+     * @brief Records the outcome of a lookup in the hit/miss counters.
+     * @param hit True if the lookup was served from the cache.
+     * @return @p hit, for convenient tail calls.
+     */
+    bool count(bool hit);
+
+    QCache<RangeKey, Block> m_blocks;      /**< LRU storage of page blocks; cost is the message count. */
+    QCache<RangeKey, Block> m_ranges;      /**< LRU storage of range answers by requested range. */
+    QHash<qint64, RangeKey> m_byFirstId;   /**< Index from first id to block range. */
+    QHash<qint64, RangeKey> m_byLastId;    /**< Index from last id to block range. */
+    QSet<RangeKey> m_tailKeys;             /**< Ranges of blocks that end at the newest message. */
+    QSet<RangeKey> m_tailRanges;           /**< Requested ranges that reach the newest message. */
+    quint64 m_hits = 0;                    /**< Lookups served from memory. */
+    quint64 m_misses = 0;                  /**< Lookups that fell through to SQLite. */
+};
+
+#endif // MESSAGEPAGECACHE_H
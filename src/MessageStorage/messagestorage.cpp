@@ -0,0 +1,92 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "messagestorage.h"
+
+#include "../MessageStore/messagestore.h"
+#include "../LogMessageStore/logmessagestore.h"
+
+#include <QDebug>
+
+MessageStorage *MessageStorage::create(const QString &backend, const QString &basePath, int instanceID, QObject *parent)
+{
+    if (backend == QLatin1String(kLogBackend)) {
+        const QString logPath = basePath + QString("/chat_log_instance_%1").arg(instanceID);
+        return new LogMessageStore(logPath, parent);
+    }
+
+    if (backend == QLatin1String(kSharedBackend))
+        return new MessageStore(basePath + "/chat_messages_shared.db", instanceID, parent, MessageStore::Layout::Shared);
+
+    if (!backend.isEmpty() && backend != QLatin1String(kSqliteBackend))
+        qWarning() << "[MessageStorage] Unknown backend" << backend << "- using" << kSqliteBackend;
+
+    const QString dbPath = basePath + QString("/chat_messages_instance_%1.db").arg(instanceID);
+    return new MessageStore(dbPath, instanceID, parent);
+} //create
+
+QFuture<qint64> MessageStorage::firstMessageIdAtAsync(const QDateTime &time)
+{
+    return QtFuture::makeReadyFuture(firstMessageIdAt(time));
+} //firstMessageIdAtAsync
+
+QFuture<MessageBatchPtr> MessageStorage::fetchLastMessagesAsync(int count)
+{
+    return QtFuture::makeReadyFuture(fetchLastMessages(count));
+} //fetchLastMessagesAsync
+
+QFuture<MessageBatchPtr> MessageStorage::fetchMessagesAfterAsync(qint64 afterId, int limit)
+{
+    return QtFuture::makeReadyFuture(fetchMessagesAfter(afterId, limit));
+} //fetchMessagesAfterAsync
+
+QFuture<MessageBatchPtr> MessageStorage::fetchMessagesBeforeAsync(qint64 beforeId, int limit)
+{
+    return QtFuture::makeReadyFuture(fetchMessagesBefore(beforeId, limit));
+} //fetchMessagesBeforeAsync
+
+QFuture<MessageBatchPtr> MessageStorage::fetchMessageRangeAsync(qint64 firstId, qint64 lastId)
+{
+    return QtFuture::makeReadyFuture(fetchMessageRange(firstId, lastId));
+} //fetchMessageRangeAsync
+
+QFuture<int> MessageStorage::messageCountAsync()
+{
+    return QtFuture::makeReadyFuture(messageCount());
+} //messageCountAsync
+
+qint64 MessageStorage::messageCountAfter(qint64 id) const
+{
+    const qint64 lastId = lastMessageId();
+    if (lastId <= 0)
+        return 0;
+    return qMax<qint64>(0, lastId - qMax(id, firstMessageId() - 1));
+} //messageCountAfter
+
+qint64 MessageStorage::firstMessageIdAfter(qint64 id) const
+{
+    const qint64 lastId = lastMessageId();
+    if (lastId <= 0 || id >= lastId)
+        return 0;
+    return qMax(id + 1, firstMessageId());
+} //firstMessageIdAfter
+
+qint64 MessageStorage::takeBackfilledId()
+{
+    return 0;
+} //takeBackfilledId
@@ -0,0 +1,232 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MESSAGESTORAGE_H
+#define MESSAGESTORAGE_H
+
+#include "structures.h"
+#include "../MessageBatch/messagebatch.h"
+#include "../UserDirectory/userdirectory.h"
+
+#include <QDateTime>
+#include <QFuture>
+#include <QList>
+#include <QString>
+
+#include <functional>
+
+class QObject;
+
+/**
+ * @class MessageStorage
+ * @brief Storage interface shared by every chat history backend.
+ *
+ * Message ids are assigned by the backend, increase monotonically and are never
+ * reused, so callers can page through history with keyset queries anchored on the
+ * id of the first or last message they already hold.
+ *
+ * Page reads return shared, immutable MessageBatch blocks. The *Async() reads
+ * never block the calling thread on disk I/O; attach a continuation with QFuture::then(context, ...)
+ * to receive them on the GUI thread. The default implementations run the
+ * synchronous query and return a ready future, which suits backends whose reads
+ * are memory accesses.
+ *
+ * Implementations:
+ *  - MessageStore: SQLite database (default).
+ *  - LogMessageStore: memory-mapped, append-only segment files.
+ */
+class MessageStorage {
+public:
+    /**
+     * @brief Backend identifiers accepted by create() and stored in the settings file.
+     */
+    static constexpr const char *kSqliteBackend = "sqlite";
+    static constexpr const char *kLogBackend = "log";
+    static constexpr const char *kSharedBackend = "shared"; ///< One deduplicating SQLite file for all local instances.
+
+    virtual ~MessageStorage() = default;
+
+    /**
+     * @brief Creates the backend selected for an application instance.
+     *
+     * Unknown backend names fall back to SQLite.
+     *
+     * @param backend kSqliteBackend, kLogBackend or kSharedBackend.
+     * @param basePath Directory holding the instance's data files.
+     * @param instanceID Unique identifier of the application instance.
+     * @param parent QObject parent that takes ownership of the backend.
+     * @return The new, not yet opened, backend.
+     */
+    static MessageStorage *create(const QString &backend, const QString &basePath, int instanceID, QObject *parent);
+
+    /**
+     * @brief Opens the backing files and prepares the store for use.
+     * @return True on success.
+     */
+    virtual bool open() = 0;
+
+    /**
+     * @brief Appends a message.
+     * @param user The name of the message sender.
+     * @param text The content of the message.
+     * @param timestamp The timestamp of the message.
+     * @param isSent Indicates whether the message was sent by the local user.
+     * @return The id of the stored message, or -1 on failure.
+     */
+    virtual qint64 insertMessage(const QString &user, const QString &text, const QDateTime &timestamp, bool isSent) = 0;
+
+    /**
+     * @brief Appends a batch of messages as efficiently as the backend allows.
+     * @param messages The messages to append, oldest first.
+     * @return True if the whole batch was stored.
+     */
+    virtual bool insertMessages(const QList<Message> &messages) = 0;
+
+    /**
+     * @brief Fetches the @p count most recent messages in chronological order.
+     */
+    virtual MessageBatchPtr fetchLastMessages(int count) = 0;
+
+    /**
+     * @brief Fetches up to @p limit messages with ids greater than @p afterId, ascending.
+     */
+    virtual MessageBatchPtr fetchMessagesAfter(qint64 afterId, int limit) = 0;
+
+    /**
+     * @brief Fetches up to @p limit messages with ids lower than @p beforeId, ascending.
+     */
+    virtual MessageBatchPtr fetchMessagesBefore(qint64 beforeId, int limit) = 0;
+
+    /**
+     * @brief Fetches every message in the inclusive id range [firstId, lastId], ascending.
+     */
+    virtual MessageBatchPtr fetchMessageRange(qint64 firstId, qint64 lastId) = 0;
+
+    /**
+     * @brief Fetches up to @p limit messages timestamped in [from, to), ascending.
+     */
+    virtual MessageBatchPtr fetchMessagesBetween(const QDateTime &from, const QDateTime &to, int limit) = 0;
+
+    /**
+     * @brief Returns the id of the first message timestamped at or after @p time.
+     *
+     * Backed by a time index, so the seek is logarithmic in the history size.
+     *
+     * @return The message id, or 0 if every message is older than @p time.
+     */
+    virtual qint64 firstMessageIdAt(const QDateTime &time) = 0;
+
+    /**
+     * @brief Asynchronous firstMessageIdAt().
+     */
+    virtual QFuture<qint64> firstMessageIdAtAsync(const QDateTime &time);
+
+    /**
+     * @brief Asynchronous fetchLastMessages().
+     */
+    virtual QFuture<MessageBatchPtr> fetchLastMessagesAsync(int count);
+
+    /**
+     * @brief Asynchronous fetchMessagesAfter().
+     */
+    virtual QFuture<MessageBatchPtr> fetchMessagesAfterAsync(qint64 afterId, int limit);
+
+    /**
+     * @brief Asynchronous fetchMessagesBefore().
+     */
+    virtual QFuture<MessageBatchPtr> fetchMessagesBeforeAsync(qint64 beforeId, int limit);
+
+    /**
+     * @brief Asynchronous fetchMessageRange().
+     */
+    virtual QFuture<MessageBatchPtr> fetchMessageRangeAsync(qint64 firstId, qint64 lastId);
+
+    /**
+     * @brief Asynchronous messageCount().
+     */
+    virtual QFuture<int> messageCountAsync();
+
+    /**
+     * @brief Streams every stored message, oldest first.
+     * @param visitor Called once per message; return false to stop.
+     * @return True if every message was visited.
+     */
+    virtual bool forEachMessage(const std::function<bool(const Message &)> &visitor) = 0;
+
+    /**
+     * @brief Returns the total number of stored messages.
+     */
+    virtual int messageCount() const = 0;
+
+    /**
+     * @brief Returns the number of stored messages with ids greater than @p id.
+     *
+     * The default works out the count from the id bounds, which is exact for
+     * backends that assign dense ids; others override it.
+     */
+    virtual qint64 messageCountAfter(qint64 id) const;
+
+    /**
+     * @brief Returns the id of the oldest stored message with an id greater than @p id.
+     *
+     * Like messageCountAfter(), the default relies on dense ids.
+     *
+     * @return The id, or 0 if no message follows @p id.
+     */
+    virtual qint64 firstMessageIdAfter(qint64 id) const;
+
+    /**
+     * @brief Returns the id of the oldest stored message, or 0 if empty.
+     */
+    virtual qint64 firstMessageId() const = 0;
+
+    /**
+     * @brief Returns the id of the newest stored message, or 0 if empty.
+     */
+    virtual qint64 lastMessageId() const = 0;
+
+    /**
+     * @brief Returns and forgets the lowest id a message was stored under at or
+     *        below the then newest id, since the last call.
+     *
+     * Only the shared layout does this, when it links a message to a row another
+     * instance stored earlier; the other backends always append above the tail.
+     *
+     * @return The id, or 0 if every message since the last call was appended.
+     */
+    virtual qint64 takeBackfilledId();
+
+    /**
+     * @brief Deletes all messages.
+     * @return True on success.
+     */
+    virtual bool clearMessages() = 0;
+
+    /**
+     * @brief Deletes old messages, keeping at least the newest @p keepCount.
+     * @return True on success.
+     */
+    virtual bool pruneMessages(int keepCount) = 0;
+
+    /**
+     * @brief Returns the interning table of all known senders.
+     */
+    virtual const UserDirectory &users() const = 0;
+};
+
+#endif // MESSAGESTORAGE_H
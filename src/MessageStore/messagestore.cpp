@@ -20,14 +20,43 @@
 
 #include "../Utils/debugmacros.h"
 
+#include <QCryptographicHash>
 #include <QDebug>
 #include <QSqlError>
 #include <QSqlQuery>
+#include <QStringList>
 #include <QVariant>
+#include <QtEndian>
 
-MessageStore::MessageStore(const QString &dbPath, int m_instanceID, QObject *parent)
+#include <atomic>
+#include <limits>
+#include <utility>
+
+namespace {
+
+/**
+ * @brief Content address of a message in the shared layout.
+ *
+ * The wire format carries no sequence number, so the identity of a datagram is
+ * its text plus the dedup time bucket it was received in; the sender is the
+ * other half of the lookup key.
+ */
+qint64 contentHash(const QString &text, qint64 bucket)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(text.toUtf8());
+    hash.addData(QByteArray(1, '\0'));
+    hash.addData(QByteArray::number(bucket));
+    return qFromBigEndian<qint64>(hash.result().constData()) & std::numeric_limits<qint64>::max();
+}
+
+} // namespace
+
+MessageStore::MessageStore(const QString &dbPath, int instanceID, QObject *parent, Layout layout, const QString &connectionName)
     : QObject(parent)
-    , m_connectionName(QString("chatdb_connection_%1").arg(m_instanceID))
+    , m_connectionName(connectionName.isEmpty() ? QString("chatdb_connection_%1").arg(instanceID) : connectionName)
+    , m_instanceID(instanceID)
+    , m_layout(layout)
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
@@ -39,6 +68,18 @@ MessageStore::MessageStore(const QString &dbPath, int m_instanceID, QObject *par
     db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
     db.setDatabaseName(dbPath);
 
+    // Other instances or a worker handle may write to the same file; wait for
+    // their transactions instead of failing.
+    db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+
+    if (m_layout == Layout::Shared) {
+        m_messageSource = QString(R"(
+            (SELECT i.message_id AS id, m.user_id AS user_id, m.text AS text, m.timestamp AS timestamp, i.is_sent AS is_sent
+             FROM instance_messages i JOIN messages m ON m.id = i.message_id
+             WHERE i.instance_id = %1)
+        )").arg(m_instanceID);
+    }
+
 #ifdef DEBUG_MODE
     qDebug() << "[MessageStore] Initialized with DB path:" << dbPath << " and connection name:" << m_connectionName;
 #endif
@@ -48,6 +89,8 @@ MessageStore::~MessageStore()
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
+    m_readPool.reset(); // joins the readers before the writer connection goes away
+
     if (!QSqlDatabase::contains(m_connectionName))
         return;
 
@@ -74,7 +117,12 @@ bool MessageStore::open()
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
-    return initializeConnection() && initializeSchema();
+    if (!initializeConnection() || !initializeSchema() || !loadUsers())
+        return false;
+
+    // Readers open lazily, so the pool is only created once the schema exists.
+    m_readPool = std::make_unique<SqliteReadPool>(db.databaseName(), m_connectionName);
+    return true;
 }//open
 
 bool MessageStore::initializeConnection()
@@ -85,6 +133,12 @@ bool MessageStore::initializeConnection()
         logDatabaseOpenError();
         return false;
     }
+
+    // WAL lets the reader pool query while this connection writes.
+    QSqlQuery query(conn());
+    if (!query.exec("PRAGMA journal_mode=WAL"))
+        qWarning() << "[MessageStore] Failed to enable WAL:" << query.lastError().text();
+
     return true;
 }//initializeConnection
 
@@ -92,196 +146,1165 @@ bool MessageStore::initializeSchema()
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
-    const QString createSql = R"(
-        CREATE TABLE IF NOT EXISTS messages (
+    QSqlQuery query(conn());
+
+    if (!query.exec(R"(
+        CREATE TABLE IF NOT EXISTS meta (
+            key TEXT PRIMARY KEY,
+            value TEXT NOT NULL
+        )
+    )")) {
+        qCritical() << "[MessageStore] Failed to create 'meta' table:" << query.lastError().text();
+        return false;
+    }
+
+    if (m_layout == Layout::Shared)
+        return createSharedTables() && createTimestampIndex() && writeSchemaVersion(kSchemaVersion);
+
+    const int schemaVersion = readSchemaVersion();
+    if (schemaVersion >= kSchemaVersion)
+        return true;
+
+    if (hasLegacyMessagesTable() && !migrateLegacyMessages())
+        return false;
+
+    // Version 2 databases only need the timestamp index.
+    return createNormalizedTables("messages") && createTimestampIndex() && writeSchemaVersion(kSchemaVersion);
+} //initializeSchema
+
+int MessageStore::readSchemaVersion() const
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    QSqlQuery query(conn());
+    if (query.exec("SELECT value FROM meta WHERE key = 'schema_version'") && query.next())
+        return query.value(0).toInt();
+
+    return 0;
+} //readSchemaVersion
+
+bool MessageStore::writeSchemaVersion(int version)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    QSqlQuery query(conn());
+    query.prepare("INSERT OR REPLACE INTO meta (key, value) VALUES ('schema_version', :version)");
+    query.bindValue(":version", QString::number(version));
+
+    if (!query.exec()) {
+        qWarning() << "[MessageStore] Failed to set schema version:" << query.lastError().text();
+        return false;
+    }
+    return true;
+} //writeSchemaVersion
+
+bool MessageStore::createNormalizedTables(const QString &messagesTable)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    QSqlQuery query(conn());
+
+    if (!query.exec(R"(
+        CREATE TABLE IF NOT EXISTS users (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            name TEXT NOT NULL UNIQUE
+        )
+    )")) {
+        qCritical() << "[MessageStore] Failed to create 'users' table:" << query.lastError().text();
+        return false;
+    }
+
+    const QString createMessagesSql = QString(R"(
+        CREATE TABLE IF NOT EXISTS %1 (
             id INTEGER PRIMARY KEY AUTOINCREMENT,
-            user TEXT NOT NULL,
+            user_id INTEGER NOT NULL REFERENCES users(id),
             text TEXT NOT NULL,
             timestamp TEXT NOT NULL,
             is_sent INTEGER DEFAULT 0
         )
-    )";
+    )").arg(messagesTable);
+
+    if (!query.exec(createMessagesSql)) {
+        qCritical() << "[MessageStore] Failed to create '" << messagesTable << "' table:" << query.lastError().text();
+        return false;
+    }
+
+    return true;
+} //createNormalizedTables
+
+bool MessageStore::createTimestampIndex()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    QSqlQuery query(conn());
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_messages_timestamp ON messages(timestamp)")) {
+        qCritical() << "[MessageStore] Failed to create timestamp index:" << query.lastError().text();
+        return false;
+    }
+    return true;
+} //createTimestampIndex
+
+bool MessageStore::createSharedTables()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    const QStringList schemaSql = {
+        R"(
+            CREATE TABLE IF NOT EXISTS users (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                name TEXT NOT NULL UNIQUE
+            )
+        )",
+        R"(
+            CREATE TABLE IF NOT EXISTS messages (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                user_id INTEGER NOT NULL REFERENCES users(id),
+                text TEXT NOT NULL,
+                timestamp TEXT NOT NULL,
+                content_hash INTEGER NOT NULL
+            )
+        )",
+        "CREATE INDEX IF NOT EXISTS idx_messages_content ON messages(user_id, content_hash)",
+        R"(
+            CREATE TABLE IF NOT EXISTS instance_messages (
+                instance_id INTEGER NOT NULL,
+                message_id INTEGER NOT NULL REFERENCES messages(id),
+                is_sent INTEGER NOT NULL DEFAULT 0,
+                PRIMARY KEY (instance_id, message_id)
+            ) WITHOUT ROWID
+        )",
+        "CREATE INDEX IF NOT EXISTS idx_instance_messages_message ON instance_messages(message_id)",
+        R"(
+            CREATE TABLE IF NOT EXISTS instance_state (
+                instance_id INTEGER PRIMARY KEY,
+                last_read_id INTEGER NOT NULL DEFAULT 0
+            )
+        )"
+    };
 
     QSqlQuery query(conn());
-    if (!query.exec(createSql)) {
-        qCritical() << "[MessageStore] Failed to create 'messages' table:" << query.lastError().text();
+    for (const QString &sql : schemaSql) {
+        if (!query.exec(sql)) {
+            qCritical() << "[MessageStore] Failed to create shared schema:" << query.lastError().text();
+            return false;
+        }
+    }
+
+    if (!dropSharedContentKey())
+        return false;
+
+    query.prepare("INSERT OR IGNORE INTO instance_state (instance_id) VALUES (:instance)");
+    query.bindValue(":instance", m_instanceID);
+    if (!query.exec()) {
+        qCritical() << "[MessageStore] Failed to register instance:" << query.lastError().text();
         return false;
     }
 
     return true;
-} //initializeSchema
+} //createSharedTables
 
-//TODO - Maybe use this at a later date
-// bool MessageStore::initializeSchemaWithVersioning()
-// {
-//     QSqlQuery query(conn());
-
-//     // 1. Create meta table if it doesn't exist
-//     if (!query.exec(R"(
-//         CREATE TABLE IF NOT EXISTS meta (
-//             key TEXT PRIMARY KEY,
-//             value TEXT NOT NULL
-//         )
-//     )")) {
-//         qCritical() << "[MessageStore] Failed to create 'meta' table:" << query.lastError().text();
-//         return false;
-//     }
-
-//     // 2. Check schema version
-//     QString schemaVersion = "0";
-//     if (query.exec("SELECT value FROM meta WHERE key = 'schema_version'") && query.next()) {
-//         schemaVersion = query.value(0).toString();
-//     }
-
-//     // 3. Apply schema based on version
-//     if (schemaVersion == "0") {
-//         // Initial schema setup
-//         const QString createMessagesSql = R"(
-//             CREATE TABLE IF NOT EXISTS messages (
-//                 id INTEGER PRIMARY KEY AUTOINCREMENT,
-//                 user TEXT NOT NULL,
-//                 text TEXT NOT NULL,
-//                 timestamp TEXT NOT NULL,
-//                 is_sent INTEGER DEFAULT 0
-//             )
-//         )";
-
-//         if (!query.exec(createMessagesSql)) {
-//             qCritical() << "[MessageStore] Failed to create 'messages' table:" << query.lastError().text();
-//             return false;
-//         }
-
-//         // Update schema version to 1
-//         QSqlQuery updateVersion(conn());
-//         updateVersion.prepare("INSERT OR REPLACE INTO meta (key, value) VALUES ('schema_version', '1')");
-//         if (!updateVersion.exec()) {
-//             qWarning() << "[MessageStore] Failed to set schema version:" << updateVersion.lastError().text();
-//             return false;
-//         }
-//     }
-
-//     // 4. Handle future migrations (example for version 2)
-//     /*
-//     if (schemaVersion == "1") {
-//         // ALTER TABLE or other migration logic here
-//         QSqlQuery alter;
-//         alter.exec("ALTER TABLE messages ADD COLUMN message_type TEXT DEFAULT 'text'");
-
-//         QSqlQuery updateVersion;
-//         updateVersion.prepare("UPDATE meta SET value = '2' WHERE key = 'schema_version'");
-//         updateVersion.exec();
-//     }
-//     */
-
-//     return true;
-// } // initializeSchemaWithVersioning
-
-void MessageStore::insertMessage(const QString &user, const QString &text, const QDateTime &timestamp, bool isSent)
+bool MessageStore::dropSharedContentKey()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    QSqlDatabase database = conn();
+    QSqlQuery query(database);
+
+    // Another instance may be rebuilding the same file; the write lock serialises the check.
+    if (!query.exec("BEGIN IMMEDIATE")) {
+        qCritical() << "[MessageStore] Failed to start shared schema upgrade:" << query.lastError().text();
+        return false;
+    }
+
+    if (!query.exec("SELECT sql FROM sqlite_master WHERE type = 'table' AND name = 'messages'") || !query.next()) {
+        qCritical() << "[MessageStore] Failed to read shared schema:" << query.lastError().text();
+        database.rollback();
+        return false;
+    }
+
+    if (!query.value(0).toString().contains("UNIQUE")) {
+        query.finish();
+        return database.commit();
+    }
+    query.finish();
+
+    const QStringList upgradeSql = {
+        R"(
+            CREATE TABLE messages_v3 (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                user_id INTEGER NOT NULL REFERENCES users(id),
+                text TEXT NOT NULL,
+                timestamp TEXT NOT NULL,
+                content_hash INTEGER NOT NULL
+            )
+        )",
+        R"(
+            INSERT INTO messages_v3 (id, user_id, text, timestamp, content_hash)
+            SELECT id, user_id, text, timestamp, content_hash FROM messages ORDER BY id
+        )",
+        "DROP TABLE messages",
+        "ALTER TABLE messages_v3 RENAME TO messages",
+        "CREATE INDEX IF NOT EXISTS idx_messages_content ON messages(user_id, content_hash)"
+    };
+
+    for (const QString &sql : upgradeSql) {
+        if (!query.exec(sql)) {
+            qCritical() << "[MessageStore] Shared schema upgrade step failed:" << query.lastError().text();
+            database.rollback();
+            return false;
+        }
+    }
+
+    if (!database.commit()) {
+        qCritical() << "[MessageStore] Failed to commit shared schema upgrade:" << database.lastError().text();
+        database.rollback();
+        return false;
+    }
+
+    qDebug() << "[MessageStore] Dropped the unique content key of the shared messages table";
+    return true;
+} //dropSharedContentKey
+
+bool MessageStore::hasLegacyMessagesTable() const
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
+    QSqlQuery query(conn());
+    if (!query.exec("PRAGMA table_info(messages)"))
+        return false;
+
+    while (query.next()) {
+        if (query.value(1).toString() == QLatin1String("user"))
+            return true;
+    }
+    return false;
+} //hasLegacyMessagesTable
+
+bool MessageStore::migrateLegacyMessages()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    QSqlDatabase database = conn();
+    if (!database.transaction()) {
+        qCritical() << "[MessageStore] Failed to start schema migration:" << database.lastError().text();
+        return false;
+    }
+
+    const QStringList migrationSql = {
+        "INSERT OR IGNORE INTO users (name) SELECT DISTINCT user FROM messages",
+        R"(
+            INSERT INTO messages_v2 (id, user_id, text, timestamp, is_sent)
+            SELECT m.id, u.id, m.text, m.timestamp, m.is_sent
+            FROM messages m JOIN users u ON u.name = m.user
+            ORDER BY m.id
+        )",
+        "DROP TABLE messages",
+        "ALTER TABLE messages_v2 RENAME TO messages"
+    };
+
+    bool ok = createNormalizedTables("messages_v2");
+
+    QSqlQuery query(database);
+    for (const QString &sql : migrationSql) {
+        if (!ok)
+            break;
+        ok = query.exec(sql);
+        if (!ok)
+            qCritical() << "[MessageStore] Schema migration step failed:" << query.lastError().text();
+    }
+
+    ok = ok && writeSchemaVersion(kSchemaVersion);
+
+    if (!ok) {
+        database.rollback();
+        return false;
+    }
+
+    if (!database.commit()) {
+        qCritical() << "[MessageStore] Failed to commit schema migration:" << database.lastError().text();
+        database.rollback();
+        return false;
+    }
+
+    qDebug() << "[MessageStore] Migrated messages to schema version" << kSchemaVersion;
+    return true;
+} //migrateLegacyMessages
+
+bool MessageStore::loadUsers()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    m_users.clear();
+
+    QSqlQuery query(conn());
+    if (!query.exec("SELECT id, name FROM users")) {
+        qCritical() << "[MessageStore] Failed to load users:" << query.lastError().text();
+        return false;
+    }
+
+    while (query.next())
+        m_users.insert(query.value(0).toInt(), query.value(1).toString());
+
+    return true;
+} //loadUsers
+
+void MessageStore::loadUser(int userId)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    QSqlQuery query(conn());
+    query.prepare("SELECT name FROM users WHERE id = :id");
+    query.bindValue(":id", userId);
+
+    if (query.exec() && query.next())
+        m_users.insert(userId, query.value(0).toString());
+} //loadUser
+
+int MessageStore::resolveUserId(const QString &user)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    const int cachedId = m_users.idForName(user);
+    if (cachedId > 0)
+        return cachedId;
+
+    QSqlQuery query(conn());
+    query.prepare("INSERT OR IGNORE INTO users (name) VALUES (:name)");
+    query.bindValue(":name", user);
+
+    if (!query.exec()) {
+        qWarning().nospace() << "[MessageStore] Failed to insert user '" << user << "': " << query.lastError().text();
+        return -1;
+    }
+
+    query.prepare("SELECT id FROM users WHERE name = :name");
+    query.bindValue(":name", user);
+
+    if (!query.exec() || !query.next()) {
+        qWarning().nospace() << "[MessageStore] Failed to resolve user '" << user << "': " << query.lastError().text();
+        return -1;
+    }
+
+    const int userId = query.value(0).toInt();
+    m_users.insert(userId, user);
+    return userId;
+} //resolveUserId
+
+qint64 MessageStore::insertMessage(const QString &user, const QString &text, const QDateTime &timestamp, bool isSent)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    const int userId = resolveUserId(user);
+    if (userId < 0)
+        return -1;
+
+    if (m_layout == Layout::Shared) {
+        qint64 messageId = -1;
+        return insertSharedMessages({{userId, text, timestamp, isSent}}, &messageId) ? messageId : -1;
+    }
+
     QSqlQuery query(conn());
     query.prepare(R"(
-        INSERT INTO messages (user, text, timestamp, is_sent)
-        VALUES (:user, :text, :timestamp, :is_sent)
+        INSERT INTO messages (user_id, text, timestamp, is_sent)
+        VALUES (:user_id, :text, :timestamp, :is_sent)
     )");
 
-    query.bindValue(":user", user);
+    query.bindValue(":user_id", userId);
     query.bindValue(":text", text);
-    query.bindValue(":timestamp", timestamp.toString(Qt::ISODate));
+    query.bindValue(":timestamp", timestampKey(timestamp));
     query.bindValue(":is_sent", isSent ? 1 : 0);
 
     if (!query.exec()) {
         qWarning().nospace() << "[MessageStore] Failed to insert message from '" << user << "': " << query.lastError().text();
+        return -1;
     }
+
+    invalidateTail();
+    m_lastMessageId = query.lastInsertId().toLongLong();
+    if (m_firstMessageId == 0)
+        m_firstMessageId = m_lastMessageId; // first message; -1 stays unknown and is re-queried
+
+    return m_lastMessageId;
 } //insertMessage
 
-Message MessageStore::extractMessageFromQuery(const QSqlQuery &query) const
+bool MessageStore::insertMessages(const QList<Message> &messages)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    if (messages.isEmpty())
+        return true;
+
+    if (m_layout == Layout::Shared) {
+        QList<SharedRow> rows;
+        rows.reserve(messages.size());
+        for (const Message &message : messages) {
+            const int userId = resolveUserId(message.user);
+            if (userId < 0)
+                return false;
+            rows.append({userId, message.text, message.timestamp, message.isSentByMe});
+        }
+        return insertSharedMessages(rows);
+    }
+
+    QSqlDatabase database = conn();
+    if (!database.transaction()) {
+        qWarning() << "[MessageStore] insertMessages could not start a transaction:" << database.lastError().text();
+        return false;
+    }
+
+    QSqlQuery query(database);
+    query.prepare(R"(
+        INSERT INTO messages (user_id, text, timestamp, is_sent)
+        VALUES (:user_id, :text, :timestamp, :is_sent)
+    )");
+
+    for (const Message &message : messages) {
+        const int userId = resolveUserId(message.user);
+
+        query.bindValue(":user_id", userId);
+        query.bindValue(":text", message.text);
+        query.bindValue(":timestamp", timestampKey(message.timestamp));
+        query.bindValue(":is_sent", message.isSentByMe ? 1 : 0);
+
+        if (userId < 0 || !query.exec()) {
+            qWarning() << "[MessageStore] insertMessages failed:" << query.lastError().text();
+            database.rollback();
+            loadUsers(); // drop ids interned inside the rolled back transaction
+            return false;
+        }
+    }
+
+    if (!database.commit()) {
+        qWarning() << "[MessageStore] insertMessages commit failed:" << database.lastError().text();
+        database.rollback();
+        loadUsers();
+        return false;
+    }
+
+    invalidateTail();
+    m_lastMessageId = -1;
+    if (m_firstMessageId == 0)
+        m_firstMessageId = -1;
+
+    return true;
+} //insertMessages
+
+bool MessageStore::insertSharedMessages(const QList<SharedRow> &rows, qint64 *lastLinkedId)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    // Only this instance links rows into its own view, so its newest id cannot move meanwhile.
+    const qint64 knownLastId = lastMessageId();
+
+    QSqlDatabase database = conn();
+    QSqlQuery query(database);
+
+    // IMMEDIATE takes the write lock up front, so the dedup lookup and the insert
+    // are atomic with respect to every other instance sharing the file.
+    if (!query.exec("BEGIN IMMEDIATE")) {
+        qWarning() << "[MessageStore] Shared insert could not start a transaction:" << query.lastError().text();
+        return false;
+    }
+
+    // Only a row this instance has not linked yet is another instance's copy of
+    // the datagram; a repeat from the sender ("ok", "yes") gets a row of its own.
+    QSqlQuery find(database);
+    find.prepare(R"(
+        SELECT m.id FROM messages m
+        WHERE m.user_id = :user_id AND m.content_hash IN (:previous, :current, :next)
+          AND NOT EXISTS (SELECT 1 FROM instance_messages i
+                          WHERE i.instance_id = :instance AND i.message_id = m.id)
+        ORDER BY m.id
+        LIMIT 1
+    )");
+
+    QSqlQuery insert(database);
+    insert.prepare(R"(
+        INSERT INTO messages (user_id, text, timestamp, content_hash)
+        VALUES (:user_id, :text, :timestamp, :hash)
+    )");
+
+    QSqlQuery link(database);
+    link.prepare(R"(
+        INSERT INTO instance_messages (instance_id, message_id, is_sent)
+        VALUES (:instance, :message_id, :is_sent)
+    )");
+
+    qint64 lowestReusedId = std::numeric_limits<qint64>::max();
+    qint64 highestLinkedId = 0;
+    bool ok = true;
+
+    for (const SharedRow &row : rows) {
+        // Neighbouring buckets are checked too, so copies received on either side
+        // of a bucket boundary still collapse into one row.
+        const qint64 bucket = row.timestamp.toMSecsSinceEpoch() / kDedupWindowMs;
+
+        find.bindValue(":user_id", row.userId);
+        find.bindValue(":instance", m_instanceID);
+        find.bindValue(":previous", contentHash(row.text, bucket - 1));
+        find.bindValue(":current", contentHash(row.text, bucket));
+        find.bindValue(":next", contentHash(row.text, bucket + 1));
+
+        if (!(ok = find.exec()))
+            break;
+
+        qint64 messageId = 0;
+        if (find.next()) {
+            messageId = find.value(0).toLongLong();
+            lowestReusedId = qMin(lowestReusedId, messageId);
+        } else {
+            insert.bindValue(":user_id", row.userId);
+            insert.bindValue(":text", row.text);
+            insert.bindValue(":timestamp", timestampKey(row.timestamp));
+            insert.bindValue(":hash", contentHash(row.text, bucket));
+
+            if (!(ok = insert.exec()))
+                break;
+            messageId = insert.lastInsertId().toLongLong();
+        }
+        find.finish();
+
+        link.bindValue(":instance", m_instanceID);
+        link.bindValue(":message_id", messageId);
+        link.bindValue(":is_sent", row.isSent ? 1 : 0);
+
+        if (!(ok = link.exec()))
+            break;
+
+        highestLinkedId = qMax(highestLinkedId, messageId);
+        if (lastLinkedId)
+            *lastLinkedId = messageId;
+    }
+
+    if (!ok) {
+        qWarning() << "[MessageStore] Shared insert failed:"
+                   << find.lastError().text() << insert.lastError().text() << link.lastError().text();
+        database.rollback();
+        loadUsers();
+        return false;
+    }
+
+    if (!database.commit()) {
+        qWarning() << "[MessageStore] Shared insert commit failed:" << database.lastError().text();
+        database.rollback();
+        loadUsers();
+        return false;
+    }
+
+    // Linking a row another instance stored earlier can land below our newest id,
+    // inside pages that were already read; views learn of it via takeBackfilledId().
+    if (lowestReusedId <= knownLastId) {
+        invalidateCaches();
+        m_backfilledId = m_backfilledId > 0 ? qMin(m_backfilledId, lowestReusedId) : lowestReusedId;
+        return true;
+    }
+
+    invalidateTail();
+    m_lastMessageId = qMax(knownLastId, highestLinkedId);
+    if (m_firstMessageId == 0)
+        m_firstMessageId = -1;
+
+    return true;
+} //insertSharedMessages
+
+bool MessageStore::forEachMessage(const std::function<bool(const Message &)> &visitor)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    QSqlQuery query(conn());
+    query.setForwardOnly(true);
+    query.prepare(QString(R"(
+        SELECT id, user_id, text, timestamp, is_sent
+        FROM %1
+        ORDER BY id ASC
+    )").arg(m_messageSource));
+
+    if (!query.exec()) {
+        qWarning().nospace() << "[MessageStore] forEachMessage failed: " << query.lastError().text();
+        return false;
+    }
+
+    while (query.next()) {
+        Message message = readRow(query);
+        attachUserName(message);
+        if (!visitor(message))
+            return false;
+    }
+
+    return true;
+} //forEachMessage
+
+Message MessageStore::readRow(const QSqlQuery &query)
 {
     // LOG_DEBUG(Q_FUNC_INFO);
 
     Message m;
-    m.user = query.value(0).toString();
-    m.text = query.value(1).toString();
-    m.timestamp = QDateTime::fromString(query.value(2).toString(), Qt::ISODate);
-    m.isSentByMe = (query.value(3).toInt() == 1);
+    m.id = query.value(0).toLongLong();
+    m.userId = query.value(1).toInt();
+    m.text = query.value(2).toString();
+    m.timestamp = QDateTime::fromString(query.value(3).toString(), Qt::ISODate);
+    m.isSentByMe = (query.value(4).toInt() == 1);
     return m;
-} //extractMessageFromQuery
+} //readRow
 
-QList<Message> MessageStore::fetchLastMessages(int count)
+void MessageStore::attachUserName(Message &message)
 {
-    LOG_DEBUG(Q_FUNC_INFO);
+    // LOG_DEBUG(Q_FUNC_INFO);
 
-    QList<Message> messages;
-    QSqlQuery query(conn());
+    if (!m_users.contains(message.userId))
+        loadUser(message.userId);
 
-    query.prepare(R"(
-        SELECT user, text, timestamp, is_sent
-        FROM messages
-        ORDER BY id DESC
-        LIMIT :limit
-    )");
-    query.bindValue(":limit", count);
+    message.user = m_users.name(message.userId); // shares the interned buffer
+} //attachUserName
+
+MessageBatchPtr MessageStore::runMessageQuery(QSqlQuery &query, const char *context)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    auto batch = std::make_shared<MessageBatch>();
 
+    query.setForwardOnly(true);
     if (!query.exec()) {
-        qWarning().nospace() << "[MessageStore] fetchLastMessages failed: " << query.lastError().text();
-        return messages;
+        qWarning().nospace() << "[MessageStore] " << context << " failed: " << query.lastError().text();
+        return batch;
     }
 
     while (query.next()) {
-        messages.append(extractMessageFromQuery(query));
+        const QDateTime timestamp = QDateTime::fromString(query.value(3).toString(), Qt::ISODate);
+        batch->append(query.value(0).toLongLong(),
+                      query.value(1).toInt(),
+                      query.value(2).toString(),
+                      timestamp.toMSecsSinceEpoch(),
+                      query.value(4).toInt() == 1 ? MessageBatch::SentByMe : 0);
     }
 
-    std::reverse(messages.begin(), messages.end()); // Return in chronological order
-    return messages;
+    return batch;
+} //runMessageQuery
+
+MessageBatchPtr MessageStore::selectPage(const QSqlDatabase &database, const QString &source, PageQuery kind, qint64 anchor, qint64 extent)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    QSqlQuery query(database);
+
+    // Newest-first pages are re-sorted by SQLite so batches are always built in ascending id order.
+    switch (kind) {
+    case PageQuery::Last:
+        query.prepare(QString(R"(
+            SELECT id, user_id, text, timestamp, is_sent FROM (
+                SELECT id, user_id, text, timestamp, is_sent
+                FROM %1
+                ORDER BY id DESC
+                LIMIT :limit
+            ) ORDER BY id ASC
+        )").arg(source));
+        query.bindValue(":limit", extent);
+        return runMessageQuery(query, "fetchLastMessages");
+
+    case PageQuery::After:
+        query.prepare(QString(R"(
+            SELECT id, user_id, text, timestamp, is_sent
+            FROM %1
+            WHERE id > :after
+            ORDER BY id ASC
+            LIMIT :limit
+        )").arg(source));
+        query.bindValue(":after", anchor);
+        query.bindValue(":limit", extent);
+        return runMessageQuery(query, "fetchMessagesAfter");
+
+    case PageQuery::Before:
+        query.prepare(QString(R"(
+            SELECT id, user_id, text, timestamp, is_sent FROM (
+                SELECT id, user_id, text, timestamp, is_sent
+                FROM %1
+                WHERE id < :before
+                ORDER BY id DESC
+                LIMIT :limit
+            ) ORDER BY id ASC
+        )").arg(source));
+        query.bindValue(":before", anchor);
+        query.bindValue(":limit", extent);
+        return runMessageQuery(query, "fetchMessagesBefore");
+
+    case PageQuery::Range:
+        query.prepare(QString(R"(
+            SELECT id, user_id, text, timestamp, is_sent
+            FROM %1
+            WHERE id BETWEEN :first AND :last
+            ORDER BY id ASC
+        )").arg(source));
+        query.bindValue(":first", anchor);
+        query.bindValue(":last", extent);
+        return runMessageQuery(query, "fetchMessageRange");
+    }
+
+    return std::make_shared<MessageBatch>();
+} //selectPage
+
+MessageBatchPtr MessageStore::finishPage(const MessageBatchPtr &batch, PageQuery kind, qint64 anchor, qint64 extent, quint64 generation)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    internSenders(*batch);
+
+    // Rows read before a clear, prune or append may be gone or incomplete by now.
+    if (generation != m_cacheGeneration)
+        return batch;
+
+    if (kind == PageQuery::Range)
+        cacheRange(anchor, extent, batch);
+    else
+        cachePage(batch, int(extent));
+    return batch;
+} //finishPage
+
+void MessageStore::internSenders(const MessageBatch &batch)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    // Renderers resolve names by id, so every sender must be in the directory.
+    for (int i = 0; i < batch.size(); ++i) {
+        if (!m_users.contains(batch.userId(i)))
+            loadUser(batch.userId(i));
+    }
+} //internSenders
+
+QFuture<MessageBatchPtr> MessageStore::fetchPageAsync(PageQuery kind, qint64 anchor, qint64 extent)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    if (!m_readPool)
+        return QtFuture::makeReadyFuture(finishPage(selectPage(conn(), m_messageSource, kind, anchor, extent), kind, anchor, extent, m_cacheGeneration));
+
+    // Rows are read on a worker; the user directory and page cache are only touched on this thread.
+    return m_readPool->run([source = m_messageSource, kind, anchor, extent](const QSqlDatabase &database) {
+                         return selectPage(database, source, kind, anchor, extent);
+                     })
+        .then(this, [this, kind, anchor, extent, generation = m_cacheGeneration](const MessageBatchPtr &batch) {
+            return finishPage(batch, kind, anchor, extent, generation);
+        });
+} //fetchPageAsync
+
+void MessageStore::cachePage(const MessageBatchPtr &batch, int limit)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    if (batch->isEmpty())
+        return;
+
+    const bool isTail = batch->lastId() >= lastMessageId();
+    m_pageCache.insert(batch, limit, isTail);
+} //cachePage
+
+void MessageStore::cacheRange(qint64 firstId, qint64 lastId, const MessageBatchPtr &batch)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    // A range reaching past the newest message gains rows on the next insert.
+    m_pageCache.insertRange(firstId, lastId, batch, lastId >= lastMessageId());
+} //cacheRange
+
+MessageBatchPtr MessageStore::fetchLastMessages(int count)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    MessageBatchPtr batch;
+    if (m_pageCache.lookupTail(count, batch))
+        return batch;
+
+    return finishPage(selectPage(conn(), m_messageSource, PageQuery::Last, 0, count), PageQuery::Last, 0, count, m_cacheGeneration);
 } //fetchLastMessages
 
-QList<Message> MessageStore::fetchMessages(int offset, int limit)
+QFuture<MessageBatchPtr> MessageStore::fetchLastMessagesAsync(int count)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    MessageBatchPtr batch;
+    if (m_pageCache.lookupTail(count, batch))
+        return QtFuture::makeReadyFuture(batch);
+
+    return fetchPageAsync(PageQuery::Last, 0, count);
+} //fetchLastMessagesAsync
+
+MessageBatchPtr MessageStore::fetchMessages(int offset, int limit)
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
-    QList<Message> messages;
     QSqlQuery query(conn());
 
-    query.prepare(R"(
-        SELECT user, text, timestamp, is_sent
-        FROM messages
+    query.prepare(QString(R"(
+        SELECT id, user_id, text, timestamp, is_sent
+        FROM %1
         ORDER BY id ASC
         LIMIT :limit OFFSET :offset
-    )");
+    )").arg(m_messageSource));
 
     query.bindValue(":limit", limit);
     query.bindValue(":offset", offset);
 
+    return runMessageQuery(query, "fetchMessages");
+} //fetchMessages
+
+MessageBatchPtr MessageStore::fetchMessagesAfter(qint64 afterId, int limit)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    MessageBatchPtr batch;
+    if (m_pageCache.lookupStartingAt(afterId + 1, limit, batch))
+        return batch;
+
+    return finishPage(selectPage(conn(), m_messageSource, PageQuery::After, afterId, limit), PageQuery::After, afterId, limit, m_cacheGeneration);
+} //fetchMessagesAfter
+
+QFuture<MessageBatchPtr> MessageStore::fetchMessagesAfterAsync(qint64 afterId, int limit)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    MessageBatchPtr batch;
+    if (m_pageCache.lookupStartingAt(afterId + 1, limit, batch))
+        return QtFuture::makeReadyFuture(batch);
+
+    return fetchPageAsync(PageQuery::After, afterId, limit);
+} //fetchMessagesAfterAsync
+
+MessageBatchPtr MessageStore::fetchMessagesBefore(qint64 beforeId, int limit)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    MessageBatchPtr batch;
+    if (m_pageCache.lookupEndingAt(beforeId - 1, limit, batch))
+        return batch;
+
+    return finishPage(selectPage(conn(), m_messageSource, PageQuery::Before, beforeId, limit), PageQuery::Before, beforeId, limit, m_cacheGeneration);
+} //fetchMessagesBefore
+
+QFuture<MessageBatchPtr> MessageStore::fetchMessagesBeforeAsync(qint64 beforeId, int limit)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    MessageBatchPtr batch;
+    if (m_pageCache.lookupEndingAt(beforeId - 1, limit, batch))
+        return QtFuture::makeReadyFuture(batch);
+
+    return fetchPageAsync(PageQuery::Before, beforeId, limit);
+} //fetchMessagesBeforeAsync
+
+MessageBatchPtr MessageStore::fetchMessageRange(qint64 firstId, qint64 lastId)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    MessageBatchPtr batch;
+    if (m_pageCache.lookupRange(firstId, lastId, batch))
+        return batch;
+
+    return finishPage(selectPage(conn(), m_messageSource, PageQuery::Range, firstId, lastId), PageQuery::Range, firstId, lastId, m_cacheGeneration);
+} //fetchMessageRange
+
+QFuture<MessageBatchPtr> MessageStore::fetchMessageRangeAsync(qint64 firstId, qint64 lastId)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    MessageBatchPtr batch;
+    if (m_pageCache.lookupRange(firstId, lastId, batch))
+        return QtFuture::makeReadyFuture(batch);
+
+    return fetchPageAsync(PageQuery::Range, firstId, lastId);
+} //fetchMessageRangeAsync
+
+QString MessageStore::timestampKey(const QDateTime &time)
+{
+    // Rows are written as UTC ISO 8601, which sorts the same textually and chronologically.
+    return time.toUTC().toString(Qt::ISODate);
+} //timestampKey
+
+MessageBatchPtr MessageStore::fetchMessagesBetween(const QDateTime &from, const QDateTime &to, int limit)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    QSqlQuery query(conn());
+    query.prepare(QString(R"(
+        SELECT id, user_id, text, timestamp, is_sent FROM (
+            SELECT id, user_id, text, timestamp, is_sent
+            FROM %1
+            WHERE timestamp >= :from AND timestamp < :to
+            ORDER BY timestamp ASC, id ASC
+            LIMIT :limit
+        ) ORDER BY id ASC
+    )").arg(m_messageSource));
+
+    query.bindValue(":from", timestampKey(from));
+    query.bindValue(":to", timestampKey(to));
+    query.bindValue(":limit", limit);
+
+    MessageBatchPtr batch = runMessageQuery(query, "fetchMessagesBetween");
+    internSenders(*batch);
+    return batch;
+} //fetchMessagesBetween
+
+qint64 MessageStore::selectFirstIdAt(const QSqlDatabase &database, const QString &source, const QString &timestamp)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    QSqlQuery query(database);
+    query.prepare(QString(R"(
+        SELECT id FROM %1
+        WHERE timestamp >= :at
+        ORDER BY timestamp ASC, id ASC
+        LIMIT 1
+    )").arg(source));
+    query.bindValue(":at", timestamp);
+
     if (!query.exec()) {
-        qWarning().nospace() << "[MessageStore] fetchMessages failed: " << query.lastError().text();
-        return messages;
+        qWarning() << "[MessageStore] firstMessageIdAt failed:" << query.lastError().text();
+        return 0;
     }
+    return query.next() ? query.value(0).toLongLong() : 0;
+} //selectFirstIdAt
 
-    while (query.next()) {
-        messages.append(extractMessageFromQuery(query));
+qint64 MessageStore::firstMessageIdAt(const QDateTime &time)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    return selectFirstIdAt(conn(), m_messageSource, timestampKey(time));
+} //firstMessageIdAt
+
+QFuture<qint64> MessageStore::firstMessageIdAtAsync(const QDateTime &time)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    if (!m_readPool)
+        return QtFuture::makeReadyFuture(firstMessageIdAt(time));
+
+    return m_readPool->run([source = m_messageSource, key = timestampKey(time)](const QSqlDatabase &database) {
+        return selectFirstIdAt(database, source, key);
+    });
+} //firstMessageIdAtAsync
+
+void MessageStore::refreshIdBounds() const
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    QSqlQuery query(QString("SELECT MIN(id), MAX(id) FROM %1").arg(m_messageSource), conn());
+    if (query.next()) {
+        m_firstMessageId = query.value(0).toLongLong(); // NULL → 0 on an empty table
+        m_lastMessageId = query.value(1).toLongLong();
+    } else {
+        m_firstMessageId = 0;
+        m_lastMessageId = 0;
     }
+} //refreshIdBounds
 
-    return messages;
-} //fetchMessages
+qint64 MessageStore::firstMessageId() const
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
 
-int MessageStore::messageCount() const
+    if (m_firstMessageId < 0)
+        refreshIdBounds();
+    return m_firstMessageId;
+} //firstMessageId
+
+qint64 MessageStore::lastMessageId() const
 {
     // LOG_DEBUG(Q_FUNC_INFO);
 
-    QSqlQuery query("SELECT COUNT(*) FROM messages", conn());
+    if (m_lastMessageId < 0)
+        refreshIdBounds();
+    return m_lastMessageId;
+} //lastMessageId
+
+qint64 MessageStore::takeBackfilledId()
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    return std::exchange(m_backfilledId, 0);
+} //takeBackfilledId
+
+std::unique_ptr<MessageStore> MessageStore::openWorkerHandle() const
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    // Connection names are process-wide, and handles may be opened from several threads.
+    static std::atomic<int> handleCount{0};
+    const QString name = QString("%1_worker_%2").arg(m_connectionName).arg(++handleCount);
+
+    auto handle = std::make_unique<MessageStore>(db.databaseName(), m_instanceID, nullptr, m_layout, name);
+    if (!handle->open())
+        return nullptr;
+    return handle;
+} //openWorkerHandle
+
+void MessageStore::refresh()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    invalidateCaches();
+} //refresh
+
+void MessageStore::invalidateCaches()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    ++m_cacheGeneration;
+    m_pageCache.clear();
+    m_firstMessageId = -1;
+    m_lastMessageId = -1;
+} //invalidateCaches
+
+void MessageStore::invalidateTail()
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    ++m_cacheGeneration;
+    m_pageCache.invalidateTail();
+} //invalidateTail
+
+int MessageStore::countMessages(const QSqlDatabase &database, const QString &source)
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    QSqlQuery query(QString("SELECT COUNT(*) FROM %1").arg(source), database);
     return query.next() ? query.value(0).toInt() : 0;
+} //countMessages
+
+int MessageStore::messageCount() const
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    return countMessages(conn(), m_messageSource);
 } //messageCount
 
+qint64 MessageStore::messageCountAfter(qint64 id) const
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    if (m_layout != Layout::Shared)
+        return MessageStorage::messageCountAfter(id);
+
+    QSqlQuery query(conn());
+    query.prepare(QString("SELECT COUNT(*) FROM %1 WHERE id > :id").arg(m_messageSource));
+    query.bindValue(":id", id);
+
+    if (!query.exec() || !query.next()) {
+        qWarning() << "[MessageStore] messageCountAfter failed:" << query.lastError().text();
+        return 0;
+    }
+    return query.value(0).toLongLong();
+} //messageCountAfter
+
+qint64 MessageStore::firstMessageIdAfter(qint64 id) const
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    if (m_layout != Layout::Shared)
+        return MessageStorage::firstMessageIdAfter(id);
+
+    QSqlQuery query(conn());
+    query.prepare(QString("SELECT MIN(id) FROM %1 WHERE id > :id").arg(m_messageSource));
+    query.bindValue(":id", id);
+
+    if (!query.exec() || !query.next()) {
+        qWarning() << "[MessageStore] firstMessageIdAfter failed:" << query.lastError().text();
+        return 0;
+    }
+    return query.value(0).toLongLong(); // NULL when nothing follows
+} //firstMessageIdAfter
+
+QFuture<int> MessageStore::messageCountAsync()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    if (!m_readPool)
+        return QtFuture::makeReadyFuture(messageCount());
+
+    return m_readPool->run([source = m_messageSource](const QSqlDatabase &database) {
+        return countMessages(database, source);
+    });
+} //messageCountAsync
+
 bool MessageStore::clearMessages()
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
+    if (m_layout == Layout::Shared)
+        return unlinkSharedMessages(std::numeric_limits<qint64>::max());
+
     QSqlQuery query("DELETE FROM messages", conn());
     if (!query.exec()) {
         qWarning() << "[MessageStore] Failed to clear messages:" << query.lastError().text();
         return false;
     }
 
+    invalidateCaches();
     return true;
 } //clearMessages
+
+bool MessageStore::pruneMessages(int keepCount)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    if (m_layout == Layout::Shared) {
+        QSqlQuery cutoff(conn());
+        cutoff.prepare(R"(
+            SELECT message_id FROM instance_messages
+            WHERE instance_id = :instance
+            ORDER BY message_id DESC LIMIT 1 OFFSET :keep
+        )");
+        cutoff.bindValue(":instance", m_instanceID);
+        cutoff.bindValue(":keep", qMax(0, keepCount));
+
+        if (!cutoff.exec()) {
+            qWarning() << "[MessageStore] Failed to prune messages:" << cutoff.lastError().text();
+            return false;
+        }
+        return !cutoff.next() || unlinkSharedMessages(cutoff.value(0).toLongLong());
+    }
+
+    QSqlQuery query(conn());
+    query.prepare(R"(
+        DELETE FROM messages
+        WHERE id <= (SELECT id FROM messages ORDER BY id DESC LIMIT 1 OFFSET :keep)
+    )");
+    query.bindValue(":keep", qMax(0, keepCount));
+
+    if (!query.exec()) {
+        qWarning() << "[MessageStore] Failed to prune messages:" << query.lastError().text();
+        return false;
+    }
+
+    invalidateCaches();
+    return true;
+} //pruneMessages
+
+bool MessageStore::unlinkSharedMessages(qint64 upToId)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    QSqlDatabase database = conn();
+    QSqlQuery query(database);
+
+    if (!query.exec("BEGIN IMMEDIATE")) {
+        qWarning() << "[MessageStore] Failed to start unlinking messages:" << query.lastError().text();
+        return false;
+    }
+
+    query.prepare("DELETE FROM instance_messages WHERE instance_id = :instance AND message_id <= :last");
+    query.bindValue(":instance", m_instanceID);
+    query.bindValue(":last", upToId);
+    bool ok = query.exec();
+
+    // Rows no instance refers to any more are garbage.
+    ok = ok && query.exec(R"(
+        DELETE FROM messages
+        WHERE NOT EXISTS (SELECT 1 FROM instance_messages i WHERE i.message_id = messages.id)
+    )");
+
+    if (!ok || !database.commit()) {
+        qWarning() << "[MessageStore] Failed to unlink messages:" << query.lastError().text() << database.lastError().text();
+        database.rollback();
+        return false;
+    }
+
+    invalidateCaches();
+    return true;
+} //unlinkSharedMessages
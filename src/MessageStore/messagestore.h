@@ -20,40 +20,16 @@
 #define MESSAGESTORE_H
 
 #include "../globals.h"
+#include "../MessageStorage/messagestorage.h"
+#include "../MessagePageCache/messagepagecache.h"
+#include "../SqliteReadPool/sqlitereadpool.h"
 
 #include <QObject>
 #include <QSqlDatabase>
 #include <QDateTime>
 #include <QList>
 
-/**
- * @struct Message
- * @brief Represents a single chat message entry in the system.
- *
- * Used for both storing messages in the database and rendering them in the UI.
- */
-struct Message {
-    /**
-     * @brief The name of the user who sent the message.
-     */
-    QString user;
-
-    /**
-     * @brief The message content.
-     */
-    QString text;
-
-    /**
-     * @brief UTC timestamp when the message was sent or received.
-     */
-    QDateTime timestamp;
-
-    /**
-     * @brief Indicates whether the message was sent by the local user.
-     * True if sent by this client, false if received from another user.
-     */
-    bool isSentByMe = false;
-};
+#include <memory>
 
 /**
  * @class MessageStore
@@ -61,11 +37,31 @@ struct Message {
  *
  * MessageStore provides an interface to insert, fetch, and manage chat messages in a persistent store.
  * It supports paged message access, initialization of the schema, and clearing stored data.
+ * Sender names are normalized into a `users` table and interned in a UserDirectory.
+ * This is the default MessageStorage backend.
+ *
+ * With Layout::Shared every instance on the host uses one database file. Message
+ * rows are content-addressed by (sender, content hash) and stored once; each
+ * instance sees the rows linked to it in `instance_messages`, which also holds
+ * the per-instance `is_sent` flag, while `instance_state` keeps its read state.
+ * A row is reused only by instances that have not linked it yet, so a sender
+ * repeating a message within the dedup window still gets two rows.
+ *
+ * Synchronous reads run on the writer connection. The *Async() reads check the
+ * page cache first and otherwise run on a SqliteReadPool of read-only
+ * connections; sender names and the cache are filled in on the store's thread.
  */
-class MessageStore : public QObject {
+class MessageStore : public QObject, public MessageStorage {
     Q_OBJECT
 
 public:
+    /**
+     * @brief How rows are laid out in the database file.
+     */
+    enum class Layout {
+        PerInstance, ///< One database per instance (default).
+        Shared       ///< One deduplicating database shared by all local instances.
+    };
 
     /**
  * @brief Constructs a MessageStore tied to a unique SQLite connection.
@@ -75,17 +71,20 @@ public:
  * of Chester The Chat to run simultaneously with independent storage backends.
  *
  * @param dbPath Path to the SQLite database file.
- * @param m_instanceID Unique identifier for the app instance (used for connection isolation).
+ * @param instanceID Unique identifier for the app instance (used for connection isolation).
  * @param parent Optional parent QObject.
+ * @param layout Per-instance file or shared deduplicating file.
+ * @param connectionName Name of the connection; defaults to one derived from @p instanceID.
  */
-    explicit MessageStore(const QString &dbPath, int m_instanceID, QObject *parent = nullptr);
+    explicit MessageStore(const QString &dbPath, int instanceID, QObject *parent = nullptr, Layout layout = Layout::PerInstance,
+                          const QString &connectionName = QString());
 
-    ~MessageStore();
+    ~MessageStore() override;
     /**
      * @brief Opens the SQLite database and initializes the message schema if necessary.
      * @return True if the database was successfully opened and initialized, false otherwise.
      */
-    bool open();
+    bool open() override;
 
     /**
      * @brief Inserts a new message into the database.
@@ -93,43 +92,311 @@ public:
      * @param text The content of the message.
      * @param timestamp The timestamp of the message.
      * @param isSent Indicates whether the message was sent by the local user.
+     * @return The id of the stored message, or -1 if the insert failed.
+     */
+    qint64 insertMessage(const QString &user, const QString &text, const QDateTime &timestamp, bool isSent) override;
+
+    /**
+     * @brief Inserts a batch of messages in a single transaction.
+     *
+     * Intended for bulk imports: one prepared statement is reused for every row
+     * and the transaction is rolled back if any row fails. Message::id and
+     * Message::userId of the input are ignored.
+     *
+     * @param messages The messages to append, oldest first.
+     * @return True if the whole batch was committed.
      */
-    void insertMessage(const QString &user, const QString &text, const QDateTime &timestamp, bool isSent);
+    bool insertMessages(const QList<Message> &messages) override;
+
+    /**
+     * @brief Streams every stored message, oldest first, to @p visitor.
+     *
+     * Uses a forward-only cursor so rows are decoded one at a time and never
+     * accumulated. Stops early when the visitor returns false.
+     *
+     * @param visitor Called once per message; return false to stop.
+     * @return True if every row was visited, false on error or early stop.
+     */
+    bool forEachMessage(const std::function<bool(const Message &)> &visitor) override;
 
     /**
      * @brief Fetches the most recent messages from the database.
      * @param count The maximum number of messages to retrieve.
-     * @return A list of Message objects in chronological order.
+     * @return A batch of messages in chronological order.
      */
-    QList<Message> fetchLastMessages(int count);
+    MessageBatchPtr fetchLastMessages(int count) override;
+
+    QFuture<MessageBatchPtr> fetchLastMessagesAsync(int count) override;
+    QFuture<MessageBatchPtr> fetchMessagesAfterAsync(qint64 afterId, int limit) override;
+    QFuture<MessageBatchPtr> fetchMessagesBeforeAsync(qint64 beforeId, int limit) override;
+    QFuture<MessageBatchPtr> fetchMessageRangeAsync(qint64 firstId, qint64 lastId) override;
+    QFuture<int> messageCountAsync() override;
 
     /**
      * @brief Fetches a specific range of messages using offset and limit.
      * @param offset The starting position of the records to fetch.
      * @param limit The maximum number of records to fetch.
-     * @return A list of Message objects in ascending order by ID.
+     * @return A batch of messages in ascending order by ID.
+     */
+    MessageBatchPtr fetchMessages(int offset, int limit);
+
+    /**
+     * @brief Fetches up to @p limit messages with ids greater than @p afterId.
+     *
+     * Keyset page query served from the page cache when possible.
+     *
+     * @param afterId Id of the last message before the page (0 for the oldest page).
+     * @param limit The maximum number of records to fetch.
+     * @return A batch of messages in ascending order by ID.
+     */
+    MessageBatchPtr fetchMessagesAfter(qint64 afterId, int limit) override;
+
+    /**
+     * @brief Fetches up to @p limit messages with ids lower than @p beforeId.
+     *
+     * Keyset page query served from the page cache when possible.
+     *
+     * @param beforeId Id of the first message after the page.
+     * @param limit The maximum number of records to fetch.
+     * @return A batch of messages in ascending order by ID.
+     */
+    MessageBatchPtr fetchMessagesBefore(qint64 beforeId, int limit) override;
+
+    /**
+     * @brief Fetches every message in the inclusive id range [firstId, lastId].
+     *
+     * Used to redraw the currently displayed page, which is normally a cache hit.
+     *
+     * @param firstId Id of the first message.
+     * @param lastId Id of the last message.
+     * @return A batch of messages in ascending order by ID.
+     */
+    MessageBatchPtr fetchMessageRange(qint64 firstId, qint64 lastId) override;
+
+    /**
+     * @brief Fetches up to @p limit messages timestamped in [from, to).
+     *
+     * Served by the `idx_messages_timestamp` index; bypasses the page cache.
+     *
+     * @return A batch of messages in ascending order by ID.
+     */
+    MessageBatchPtr fetchMessagesBetween(const QDateTime &from, const QDateTime &to, int limit) override;
+
+    /**
+     * @brief Returns the id of the first message timestamped at or after @p time, or 0 if none.
+     *
+     * A single descent of the timestamp index.
+     */
+    qint64 firstMessageIdAt(const QDateTime &time) override;
+
+    QFuture<qint64> firstMessageIdAtAsync(const QDateTime &time) override;
+
+    /**
+     * @brief Returns the id of the oldest stored message, or 0 if the store is empty.
      */
-    QList<Message> fetchMessages(int offset, int limit);
+    qint64 firstMessageId() const override;
+
+    /**
+     * @brief Returns the id of the newest stored message, or 0 if the store is empty.
+     */
+    qint64 lastMessageId() const override;
+
+    qint64 takeBackfilledId() override;
+
+    /**
+     * @brief Opens another store on the same file, with the same layout and instance.
+     *
+     * Lets a worker thread write through its own connection. Call it on that
+     * thread and destroy the store there; call refresh() on this store once the
+     * other one has written.
+     *
+     * @return The opened store, or nullptr if the database could not be opened.
+     */
+    std::unique_ptr<MessageStore> openWorkerHandle() const;
+
+    /**
+     * @brief Drops the page cache and id bounds so rows written elsewhere are read back.
+     */
+    void refresh();
 
     /**
      * @brief Returns the total number of messages stored in the database.
      * @return The total message count.
      */
-    int messageCount() const;
+    int messageCount() const override;
+
+    /**
+     * @brief Returns the number of messages with ids greater than @p id.
+     *
+     * Ids are dense in the per-instance layout; the shared layout's ids are
+     * global across instances, so its rows are counted.
+     */
+    qint64 messageCountAfter(qint64 id) const override;
+
+    /**
+     * @brief Returns the id of the oldest message with an id greater than @p id, or 0.
+     *
+     * Looked up in the shared layout, whose ids have gaps; worked out from the
+     * id bounds otherwise.
+     */
+    qint64 firstMessageIdAfter(qint64 id) const override;
 
     /**
      * @brief Deletes all messages from the database.
      * @return True if the operation was successful, false otherwise.
      */
-    bool clearMessages();
+    bool clearMessages() override;
+
+    /**
+     * @brief Deletes all but the newest @p keepCount messages.
+     * @param keepCount Number of most recent messages to keep.
+     * @return True if the operation was successful, false otherwise.
+     */
+    bool pruneMessages(int keepCount) override;
+
+    /**
+     * @brief Returns the page cache in front of the database, for hit/miss statistics.
+     */
+    const MessagePageCache &pageCache() const { return m_pageCache; }
+
+    /**
+     * @brief Returns the interning table of all known senders.
+     *
+     * Renderers use it to resolve a Message::userId to its shared name and
+     * precomputed color without hashing the name again.
+     */
+    const UserDirectory &users() const override { return m_users; }
 
 private:
     /**
-     * @brief Initializes the database schema if it doesn't exist.
-     * @return True if schema initialization succeeded, false otherwise.
+     * @brief Current on-disk schema version written to the `meta` table.
+     *
+     * Version 1 stored the sender name as TEXT in every row. Version 2 moves
+     * sender names into the `users` table referenced by `messages.user_id`.
+     * Version 3 adds the `idx_messages_timestamp` index used by time seeks.
+     */
+    static constexpr int kSchemaVersion = 3;
+
+    /**
+     * @brief Width of the time bucket used to recognise the same datagram in the shared layout.
+     */
+    static constexpr qint64 kDedupWindowMs = 2000;
+
+    /**
+     * @brief One message of a shared-layout insert, with its sender already resolved.
+     */
+    struct SharedRow {
+        int userId;
+        QString text;
+        QDateTime timestamp;
+        bool isSent;
+    };
+
+    /**
+     * @brief Initializes the database schema with version tracking support.
+     *
+     * Creates the `meta` table, then either creates a fresh schema or migrates a
+     * legacy version 1 `messages` table to the normalized layout, and finally
+     * adds the timestamp index.
+     *
+     * @return True if schema initialization or upgrade was successful, false otherwise.
      */
     bool initializeSchema();
 
+    /**
+     * @brief Reads the schema version stored in the `meta` table.
+     * @return The stored version, or 0 if none has been written yet.
+     */
+    int readSchemaVersion() const;
+
+    /**
+     * @brief Writes the schema version into the `meta` table.
+     * @param version The version number to store.
+     * @return True on success.
+     */
+    bool writeSchemaVersion(int version);
+
+    /**
+     * @brief Creates the `users` and `messages` tables of the current schema.
+     * @param messagesTable Name to give the messages table (used during migration).
+     * @return True on success.
+     */
+    bool createNormalizedTables(const QString &messagesTable);
+
+    /**
+     * @brief Creates the index on `messages.timestamp` behind the time-based queries.
+     * @return True on success.
+     */
+    bool createTimestampIndex();
+
+    /**
+     * @brief Creates the content-addressed tables of the shared layout and registers this instance.
+     * @return True on success.
+     */
+    bool createSharedTables();
+
+    /**
+     * @brief Rebuilds a shared `messages` table created with a UNIQUE (user_id, content_hash) key.
+     *
+     * The key made a sender's repeated message collapse into the first copy.
+     * Rows keep their ids, so links in `instance_messages` stay valid.
+     *
+     * @return True if the table has no such key (any more).
+     */
+    bool dropSharedContentKey();
+
+    /**
+     * @brief Stores messages in the shared layout, reusing rows another instance already stored.
+     * @param rows The messages, oldest first.
+     * @param lastLinkedId Receives the id the last row was linked to; may be null.
+     * @return True if the whole batch was committed.
+     */
+    bool insertSharedMessages(const QList<SharedRow> &rows, qint64 *lastLinkedId = nullptr);
+
+    /**
+     * @brief Unlinks this instance's messages up to @p upToId and drops orphaned rows.
+     * @return True on success.
+     */
+    bool unlinkSharedMessages(qint64 upToId);
+
+    /**
+     * @brief Returns true if a version 1 `messages` table with a TEXT `user` column exists.
+     */
+    bool hasLegacyMessagesTable() const;
+
+    /**
+     * @brief Migrates a version 1 database to the normalized `users` layout.
+     *
+     * Runs in a single transaction: distinct sender names are copied into `users`,
+     * rows are copied into a new `messages` table with `user_id` references while
+     * keeping their ids, and the old table is dropped.
+     *
+     * @return True if the migration committed, false if it was rolled back.
+     */
+    bool migrateLegacyMessages();
+
+    /**
+     * @brief Loads every row of the `users` table into the UserDirectory.
+     * @return True on success.
+     */
+    bool loadUsers();
+
+    /**
+     * @brief Returns the id for a sender name, inserting it into `users` if needed.
+     * @param user The sender name.
+     * @return The user id, or -1 on failure.
+     */
+    int resolveUserId(const QString &user);
+
+    /**
+     * @brief Resolves a user id that is not in the UserDirectory yet.
+     *
+     * Only happens when another connection added the user after loadUsers().
+     *
+     * @param userId The id to look up.
+     */
+    void loadUser(int userId);
+
     /**
  * @brief Retrieves the QSqlDatabase connection associated with this instance.
  *
@@ -147,11 +414,108 @@ private:
     void logDatabaseOpenError() const;
 
     /**
-     * @brief Extracts a Message object from a query result row.
+     * @brief Shapes of the keyset page queries shared by the sync and async reads.
+     */
+    enum class PageQuery {
+        Last,   ///< Newest `extent` rows.
+        After,  ///< Up to `extent` rows with id > `anchor`.
+        Before, ///< Up to `extent` rows with id < `anchor`.
+        Range   ///< Rows with ids in [`anchor`, `extent`].
+    };
+
+    /**
+     * @brief Extracts a Message from a query result row, without its sender name.
      * @param query The current row in the executed query.
      * @return The extracted Message.
      */
-    Message extractMessageFromQuery(const QSqlQuery &query) const;
+    static Message readRow(const QSqlQuery &query);
+
+    /**
+     * @brief Fills Message::user from the UserDirectory, loading unknown users.
+     */
+    void attachUserName(Message &message);
+
+    /**
+     * @brief Executes a prepared message query and packs all result rows into a batch.
+     * @param query A prepared query selecting id, user_id, text, timestamp, is_sent in ascending id order.
+     * @param context Name of the calling method, used in the warning on failure.
+     * @return The rows as a batch; empty on failure.
+     */
+    static MessageBatchPtr runMessageQuery(QSqlQuery &query, const char *context);
+
+    /**
+     * @brief Runs a page query on @p database. Safe to call from a reader thread.
+     * @param source Relation to read, see m_messageSource.
+     * @return The page in ascending id order.
+     */
+    static MessageBatchPtr selectPage(const QSqlDatabase &database, const QString &source, PageQuery kind, qint64 anchor, qint64 extent);
+
+    /**
+     * @brief Makes sure every sender of a fetched page is interned, then caches it.
+     * @param batch The page from selectPage().
+     * @param kind, anchor, extent The query @p batch answers, as passed to selectPage().
+     * @param generation m_cacheGeneration when the query was issued; the page
+     *        is not cached if the cache was invalidated since.
+     * @return @p batch.
+     */
+    MessageBatchPtr finishPage(const MessageBatchPtr &batch, PageQuery kind, qint64 anchor, qint64 extent, quint64 generation);
+
+    /**
+     * @brief Loads the directory entry of every sender in @p batch that is not interned yet.
+     */
+    void internSenders(const MessageBatch &batch);
+
+    /**
+     * @brief Looks up the first message at or after @p timestamp on @p database. Safe to call from a reader thread.
+     * @param timestamp Bound in the stored format, see timestampKey().
+     * @return The message id, or 0 if none.
+     */
+    static qint64 selectFirstIdAt(const QSqlDatabase &database, const QString &source, const QString &timestamp);
+
+    /**
+     * @brief Formats @p time the way rows store it, so index comparisons are textual.
+     */
+    static QString timestampKey(const QDateTime &time);
+
+    /**
+     * @brief Runs a page query on the reader pool and finishes it on this thread.
+     */
+    QFuture<MessageBatchPtr> fetchPageAsync(PageQuery kind, qint64 anchor, qint64 extent);
+
+    /**
+     * @brief Counts the rows of `messages` on @p database. Safe to call from a reader thread.
+     */
+    static int countMessages(const QSqlDatabase &database, const QString &source);
+
+    /**
+     * @brief Stores a fetched page in the cache, flagging it if it reaches the newest message.
+     * @param batch The page in ascending id order.
+     * @param limit The page size the query was issued with.
+     */
+    void cachePage(const MessageBatchPtr &batch, int limit);
+
+    /**
+     * @brief Stores the answer to an id range query under the range that was asked for.
+     *
+     * Pages of the chat view are id-aligned and often hold fewer ids than they
+     * span, so they are found again by the requested bounds, not the ids inside.
+     */
+    void cacheRange(qint64 firstId, qint64 lastId, const MessageBatchPtr &batch);
+
+    /**
+     * @brief Reloads the cached oldest/newest ids from the database.
+     */
+    void refreshIdBounds() const;
+
+    /**
+     * @brief Drops all cached pages and id bounds after rows were deleted.
+     */
+    void invalidateCaches();
+
+    /**
+     * @brief Drops the cached tail page after rows were appended.
+     */
+    void invalidateTail();
 
     /**
      * @brief The internal database instance.
@@ -167,17 +531,33 @@ private:
  */
     QString m_connectionName;
 
+    int m_instanceID = 0;                   /**< Instance owning this store. */
+    Layout m_layout = Layout::PerInstance;  /**< Database layout in use. */
+
     /**
- * @brief Initializes the database schema with version tracking support.
- *
- * Creates required tables including a `meta` table to track the schema version.
- * If no version is present, it initializes the `messages` table and sets version to 1.
- * Future schema migrations can be handled based on the current version value stored in `meta`.
- *
- * @return True if schema initialization or upgrade was successful, false otherwise.
- * @note NOT CURRENTLY USED - For possible future expansion
- */
-    bool initializeSchemaWithVersioning();
+     * @brief Relation every read selects from: `messages`, or the instance's view of the shared tables.
+     */
+    QString m_messageSource = QStringLiteral("messages");
+
+    /**
+     * @brief Interned sender names and colors, mirrored from the `users` table.
+     */
+    UserDirectory m_users;
+
+    /**
+     * @brief LRU cache of decoded pages in front of SQLite.
+     */
+    MessagePageCache m_pageCache;
+
+    /**
+     * @brief Read-only connections serving the asynchronous queries; created by open().
+     */
+    std::unique_ptr<SqliteReadPool> m_readPool;
+
+    mutable qint64 m_firstMessageId = -1; /**< Cached MIN(id); -1 when unknown. */
+    mutable qint64 m_lastMessageId = -1;  /**< Cached MAX(id); -1 when unknown. */
+    quint64 m_cacheGeneration = 0;        /**< Bumped on every cache invalidation; older reads are not cached. */
+    qint64 m_backfilledId = 0;            /**< Lowest id linked at or below the tail since takeBackfilledId(); 0 if none. */
 
     /**
  * @brief Opens the configured SQLite database connection.
@@ -192,18 +572,6 @@ private:
  */
     bool initializeConnection();
 
-    /**
- * @brief Initializes the database schema with version tracking support.
- *
- * Creates required tables including a `meta` table to track the schema version.
- * If no version is present, it initializes the `messages` table and sets version to 1.
- * Future schema migrations can be handled based on the current version value stored in `meta`.
- *
- // * @return True if schema initialization or upgrade was successful, false otherwise.
- // * @note NOT CURRENTLY USED - For possible future expansion
- // */
- //    bool initializeSchemaWithVersioning();
-
 };
 
 #endif // MESSAGESTORE_H
@@ -18,6 +18,7 @@
 
 #include "settingsmanager.h"
 #include "../Utils/debugmacros.h"
+#include "../MessageStorage/messagestorage.h"
 
 SettingsManager::SettingsManager(int instanceID, const QString &appPath, QObject *parent)
     : QObject(parent), m_instanceID(instanceID), m_appPath(appPath)
@@ -26,7 +27,7 @@ SettingsManager::SettingsManager(int instanceID, const QString &appPath, QObject
 
 }
 
-void SettingsManager::load(Settings &s)
+void SettingsManager::load(Settings &s) const
 {
     LOG_DEBUG(Q_FUNC_INFO);
 
@@ -34,7 +35,8 @@ void SettingsManager::load(Settings &s)
     .arg(m_appPath)
         .arg(m_instanceID);
 
-    QSettings settings(settingsFile, QSettings::IniFormat, this);
+    // No parent: startup reads the settings on a worker thread.
+    QSettings settings(settingsFile, QSettings::IniFormat);
 
     // Style settings
     s.stylesheetName = settings.value("StyleSheetName", "").toString();
@@ -52,6 +54,9 @@ void SettingsManager::load(Settings &s)
 
     // Identity
     s.userName = settings.value("UserName", "Chester").toString();
+
+    // Memory
+    s.maxLiveMessages = settings.value("MaxLiveMessages", 3072).toInt();
 }//load
 
 void SettingsManager::save(const Settings &s)
@@ -80,6 +85,9 @@ void SettingsManager::save(const Settings &s)
 
     // Identity
     settings.setValue("UserName", s.userName);
+
+    // Memory
+    settings.setValue("MaxLiveMessages", s.maxLiveMessages);
 }//save
 
 void SettingsManager::saveGeometry(const QByteArray &geometry)
@@ -98,3 +106,27 @@ QByteArray SettingsManager::loadGeometry() const
     return settings.value("WindowGeometry").toByteArray();
 }//loadGeometry
 
+void SettingsManager::saveLastReadId(qint64 messageId)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    QSettings settings(m_appPath + QString("/instance_%1_settings.ini").arg(m_instanceID), QSettings::IniFormat);
+    settings.setValue("LastReadId", messageId);
+}//saveLastReadId
+
+qint64 SettingsManager::loadLastReadId() const
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    QSettings settings(m_appPath + QString("/instance_%1_settings.ini").arg(m_instanceID), QSettings::IniFormat);
+    return settings.value("LastReadId", -1).toLongLong();
+}//loadLastReadId
+
+QString SettingsManager::loadStorageBackend() const
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    QSettings settings(m_appPath + QString("/instance_%1_settings.ini").arg(m_instanceID), QSettings::IniFormat);
+    return settings.value("StorageBackend", MessageStorage::kSqliteBackend).toString();
+}//loadStorageBackend
+
@@ -64,6 +64,14 @@ struct Settings {
 
     /** @brief The display name of the user. */
     QString userName;
+
+    /**
+     * @brief Upper bound on chat messages held in memory for the chat view.
+     *
+     * Older pages are trimmed and re-read from storage when scrolled back to.
+     * Lower it on always-on machines to cap memory further.
+     */
+    int maxLiveMessages = 3072;
 };
 
 
@@ -90,9 +98,12 @@ public:
 
     /**
      * @brief Loads application settings into the provided Settings struct.
+     *
+     * Only reads the instance's file, so it may run on a worker thread.
+     *
      * @param s Reference to the Settings object to populate.
      */
-    void load(Settings &s);
+    void load(Settings &s) const;
 
     /**
      * @brief Saves the current Settings struct to persistent storage.
@@ -112,6 +123,30 @@ public:
      */
     QByteArray loadGeometry() const;
 
+    /**
+     * @brief Saves the id of the newest message the user has seen.
+     * @param messageId The last read message id.
+     */
+    void saveLastReadId(qint64 messageId);
+
+    /**
+     * @brief Loads the id saved by saveLastReadId().
+     * @return The last read message id, or -1 if none was saved yet.
+     */
+    qint64 loadLastReadId() const;
+
+    /**
+     * @brief Loads the chat history backend configured for this instance.
+     *
+     * Read before the regular settings because the store is created early.
+     * Set `StorageBackend=log` in the instance's settings file to use the
+     * memory-mapped log instead of SQLite, or `StorageBackend=shared` to let
+     * every instance on the host share one deduplicated database.
+     *
+     * @return "sqlite" (default), "log" or "shared".
+     */
+    QString loadStorageBackend() const;
+
     /**
      * @brief Updates a setting reference only if the new value is different.
      * @tparam T The type of the setting.
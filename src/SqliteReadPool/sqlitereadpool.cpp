@@ -0,0 +1,70 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sqlitereadpool.h"
+
+#include "../Utils/debugmacros.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+#include <QSqlError>
+#include <QThread>
+
+SqliteReadPool::SqliteReadPool(const QString &dbPath, const QString &connectionPrefix, int threadCount)
+    : m_dbPath(dbPath)
+    , m_connectionPrefix(connectionPrefix)
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    m_pool.setMaxThreadCount(qMax(1, threadCount));
+    m_pool.setExpiryTimeout(-1); // connections are bound to their thread
+} //SqliteReadPool
+
+SqliteReadPool::~SqliteReadPool()
+{
+    LOG_DEBUG(Q_FUNC_INFO);
+
+    m_pool.clear();
+    m_pool.waitForDone();
+
+    // Workers are idle now, so no query can still be using a connection.
+    QMutexLocker locker(&m_mutex);
+    for (const QString &name : std::as_const(m_connectionNames))
+        QSqlDatabase::removeDatabase(name);
+} //~SqliteReadPool
+
+QSqlDatabase SqliteReadPool::connectionForCurrentThread()
+{
+    // LOG_DEBUG(Q_FUNC_INFO);
+
+    const QString name = QString("%1_reader_%2").arg(m_connectionPrefix).arg(quintptr(QThread::currentThreadId()));
+
+    if (QSqlDatabase::contains(name))
+        return QSqlDatabase::database(name);
+
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+    db.setDatabaseName(m_dbPath);
+    db.setConnectOptions("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=2000");
+
+    if (!db.open())
+        qWarning() << "[SqliteReadPool] Failed to open reader connection:" << db.lastError().text();
+
+    QMutexLocker locker(&m_mutex);
+    m_connectionNames.append(name);
+    return db;
+} //connectionForCurrentThread
@@ -0,0 +1,93 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SQLITEREADPOOL_H
+#define SQLITEREADPOOL_H
+
+#include <QFuture>
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <type_traits>
+
+/**
+ * @class SqliteReadPool
+ * @brief Runs read-only SQLite queries on a small pool of worker threads.
+ *
+ * Qt SQL connections may only be used by the thread that created them, so each
+ * worker lazily opens its own read-only connection, named after the owning store
+ * and the worker thread, the first time it runs a task. Worker threads never
+ * expire, which keeps those connections (and SQLite's page cache) warm.
+ *
+ * The database should be in WAL mode so that readers neither block nor are
+ * blocked by the writer connection on the GUI thread.
+ */
+class SqliteReadPool {
+public:
+    /// Number of reader threads used when none is given.
+    static constexpr int kDefaultThreadCount = 2;
+
+    /**
+     * @brief Creates a pool for the database at @p dbPath.
+     * @param dbPath Path of the SQLite database file.
+     * @param connectionPrefix Prefix for the per-thread connection names.
+     * @param threadCount Number of reader threads.
+     */
+    SqliteReadPool(const QString &dbPath, const QString &connectionPrefix, int threadCount = kDefaultThreadCount);
+
+    /**
+     * @brief Waits for running queries and removes every reader connection.
+     */
+    ~SqliteReadPool();
+
+    /**
+     * @brief Runs @p task on a worker thread with that thread's reader connection.
+     *
+     * The task must only touch the database it is given and its own captures;
+     * use QFuture::then() with a context object to get the result back on the
+     * GUI thread.
+     *
+     * @param task Callable taking a `const QSqlDatabase &`.
+     * @return A future holding the task's result.
+     */
+    template <typename Task>
+    auto run(Task task) -> QFuture<std::invoke_result_t<Task, const QSqlDatabase &>>
+    {
+        return QtConcurrent::run(&m_pool, [this, task]() {
+            return task(connectionForCurrentThread());
+        });
+    }
+
+private:
+    /**
+     * @brief Returns the calling worker's reader connection, opening it on first use.
+     */
+    QSqlDatabase connectionForCurrentThread();
+
+    QThreadPool m_pool;            /**< Reader threads. */
+    QString     m_dbPath;          /**< Database every reader opens. */
+    QString     m_connectionPrefix; /**< Prefix of reader connection names. */
+    QMutex      m_mutex;           /**< Guards m_connectionNames. */
+    QStringList m_connectionNames; /**< Reader connections to remove on destruction. */
+};
+
+#endif // SQLITEREADPOOL_H
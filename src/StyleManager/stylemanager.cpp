@@ -2,30 +2,181 @@
 
 
 #include <QApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QFileInfo>
+#include <QSettings>
 #include <QTextStream>
+#include <QtConcurrent/QtConcurrentRun>
 
-StyleManager::StyleManager() {}
+StyleManager::StyleManager(QWidget *target)
+    : target(target)
+{}
+
+QMap<QString, QString> StyleManager::loadCatalogue(const QString &folderPath, const QString &cachePath)
+{
+    const QString root = QDir(folderPath).absolutePath();
+    QSettings cache(cachePath, QSettings::IniFormat);
+
+    if (cache.value("Folder").toString() != root)
+        return scanCatalogue(root, cachePath);
+
+    // A directory's time changes when entries are added, removed or renamed in it.
+    const int directoryCount = cache.beginReadArray("Directories");
+    for (int i = 0; i < directoryCount; ++i) {
+        cache.setArrayIndex(i);
+        const QFileInfo directory(cache.value("Path").toString());
+        if (!directory.isDir() || directory.lastModified().toMSecsSinceEpoch() != cache.value("Modified").toLongLong()) {
+            cache.endArray();
+            return scanCatalogue(root, cachePath);
+        }
+    }
+    cache.endArray();
+
+    if (directoryCount == 0)
+        return scanCatalogue(root, cachePath);
+
+    QMap<QString, QString> map;
+    const int styleSheetCount = cache.beginReadArray("StyleSheets");
+    for (int i = 0; i < styleSheetCount; ++i) {
+        cache.setArrayIndex(i);
+        map.insert(cache.value("Name").toString(), cache.value("Path").toString());
+    }
+    cache.endArray();
+    return map;
+}//
+
+QMap<QString, QString> StyleManager::scanCatalogue(const QString &folderPath, const QString &cachePath)
+{
+    QMap<QString, QString> map;
+    QStringList directories;
+
+    if (QFileInfo(folderPath).isDir())
+        directories.append(folderPath);
+
+    QDirIterator it(folderPath, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QFileInfo fileInfo(it.next());
+        if (fileInfo.isDir())
+            directories.append(fileInfo.absoluteFilePath());
+        else if (fileInfo.suffix() == "qss")
+            map.insert(fileInfo.baseName(), fileInfo.absoluteFilePath());
+    }
+
+    QSettings cache(cachePath, QSettings::IniFormat);
+    cache.clear();
+    cache.setValue("Folder", folderPath);
+
+    cache.beginWriteArray("Directories", directories.size());
+    for (int i = 0; i < directories.size(); ++i) {
+        cache.setArrayIndex(i);
+        cache.setValue("Path", directories.at(i));
+        cache.setValue("Modified", QFileInfo(directories.at(i)).lastModified().toMSecsSinceEpoch());
+    }
+    cache.endArray();
+
+    cache.beginWriteArray("StyleSheets", map.size());
+    int index = 0;
+    for (auto entry = map.cbegin(); entry != map.cend(); ++entry, ++index) {
+        cache.setArrayIndex(index);
+        cache.setValue("Name", entry.key());
+        cache.setValue("Path", entry.value());
+    }
+    cache.endArray();
+
+    return map;
+}//
 
 void StyleManager::setStyleSheetMap(const QMap<QString, QString> &map) {
     styleSheetMap = map;
+    styleSheetTexts.clear();
+    pendingStyleSheetTexts.clear();
 }//
 
 bool StyleManager::loadStyleSheet(const QString &name)
 {
     if (!styleSheetMap.contains(name)){
-        qApp->setStyleSheet("");
+        applyStyleSheet(QString());
         return true;
     }
 
     currentStyle = name;
-    loadedStyle = readStyleSheetFile(styleSheetMap.value(name));
+    loadedStyle = styleSheetText(name);
     if (loadedStyle.isEmpty()) return false;
-    qApp->setStyleSheet(loadedStyle);
+    applyStyleSheet(loadedStyle);
+
+    preloadNeighbours(name);
     return true;
 }//
 
-QString StyleManager::readStyleSheetFile(const QString &path) const {
+void StyleManager::applyStyleSheet(const QString &text)
+{
+    if (text == appliedStyle)
+        return; // nothing to repolish
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (target) {
+        // Hold back painting so the repolished window is drawn once, not per widget.
+        const bool wasUpdating = target->updatesEnabled();
+        target->setUpdatesEnabled(false);
+        target->setStyleSheet(text);
+        target->setUpdatesEnabled(wasUpdating);
+    } else {
+        qApp->setStyleSheet(text);
+    }
+    appliedStyle = text;
+
+    const double elapsedMs = timer.nsecsElapsed() / 1e6;
+    ++timing.switches;
+    timing.lastMs = elapsedMs;
+    timing.slowestMs = qMax(timing.slowestMs, elapsedMs);
+    timing.totalMs += elapsedMs;
+}//
+
+QString StyleManager::styleSheetText(const QString &name)
+{
+    auto cached = styleSheetTexts.constFind(name);
+    if (cached != styleSheetTexts.constEnd())
+        return cached.value();
+
+    QString text;
+    auto pending = pendingStyleSheetTexts.find(name);
+    if (pending != pendingStyleSheetTexts.end()) {
+        text = pending->result(); // usually finished already
+        pendingStyleSheetTexts.erase(pending);
+    } else {
+        text = readStyleSheetFile(styleSheetMap.value(name));
+    }
+
+    // Unreadable files are not remembered, so they are tried again next time.
+    if (!text.isEmpty())
+        styleSheetTexts.insert(name, text);
+    return text;
+}//
+
+void StyleManager::preloadNeighbours(const QString &name)
+{
+    const QStringList names = styleSheetMap.keys();
+    const qsizetype index = names.indexOf(name);
+    if (index < 0 || names.size() < 2)
+        return;
+
+    // The combo box and the demo rotation both step through the names in map order.
+    for (const qsizetype neighbour : {index + 1, index - 1 + names.size()}) {
+        const QString &next = names.at(neighbour % names.size());
+        if (styleSheetTexts.contains(next) || pendingStyleSheetTexts.contains(next))
+            continue;
+
+        pendingStyleSheetTexts.insert(next, QtConcurrent::run(&StyleManager::readStyleSheetFile, styleSheetMap.value(next)));
+    }
+}//
+
+QString StyleManager::readStyleSheetFile(const QString &path) {
     QFile file(path);
     if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
         return "";
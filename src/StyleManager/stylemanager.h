@@ -24,6 +24,9 @@
 
 #include <QString>
 #include <QMap>
+#include <QHash>
+#include <QFuture>
+#include <QPointer>
 #include <QTextEdit>
 
 /**
@@ -33,20 +36,61 @@
 
 /**
  * @class StyleManager
- * @brief Loads .qss files and applies them to the QApplication.
+ * @brief Loads .qss files and applies them to a window or the QApplication.
  *
  * StyleManager maintains a mapping from human-readable style names to
  * stylesheet file paths. It can load a selected stylesheet and apply it
- * globally to the application, as well as report the currently active style.
+ * to its target window, or globally to the application when it has none,
+ * as well as report the currently active style.
+ *
+ * Applying a stylesheet makes Qt parse it and repolish every widget it covers,
+ * so a window target keeps a switch to that window's widgets (their tooltips
+ * and popups follow them) instead of every widget in the application. The
+ * window's painting is held back during the switch so it is redrawn once, and
+ * re-applying the text already in place does nothing. The duration of each
+ * switch is recorded in switchTiming().
+ *
+ * The mapping comes from loadCatalogue(), which keeps the result of the last
+ * folder scan on disk and trusts it while no directory below the folder has
+ * changed. Each stylesheet's text is read from disk at most once and then
+ * served from memory; after a style is applied, the styles next to it in the
+ * map are read on a worker thread so the next pick is already in memory.
  */
 class StyleManager {
 public:
+    /**
+     * @brief Durations of the stylesheet switches applied so far.
+     */
+    struct SwitchTiming {
+        int switches = 0;        ///< Number of switches measured.
+        double lastMs = 0.0;     ///< Duration of the latest switch.
+        double slowestMs = 0.0;  ///< Duration of the slowest switch.
+        double totalMs = 0.0;    ///< Sum of all switch durations.
+    };
+
     /**
      * @brief Constructs an empty StyleManager.
      *
      * Initializes with no stylesheet mapping and no currently loaded style.
+     *
+     * @param target Window the stylesheets are applied to; nullptr applies
+     *        them to the whole QApplication.
      */
-    StyleManager();
+    explicit StyleManager(QWidget *target = nullptr);
+
+    /**
+     * @brief Returns the stylesheets below @p folderPath, by display name.
+     *
+     * The catalogue saved at @p cachePath is used as long as the folder and
+     * every directory below it still have the modification times recorded with
+     * it; otherwise the folder is scanned again and the catalogue rewritten.
+     * Touches no StyleManager state, so it may run on a worker thread.
+     *
+     * @param folderPath Root folder holding the .qss files, searched recursively.
+     * @param cachePath INI file the catalogue is kept in.
+     * @return Map of display names to absolute .qss file paths.
+     */
+    static QMap<QString, QString> loadCatalogue(const QString &folderPath, const QString &cachePath);
 
     /**
      * @brief Sets the map of available styles.
@@ -59,7 +103,7 @@ public:
      *
      * If @p name is not found in the map, clears any existing stylesheet.
      * Otherwise, reads the file at the mapped path and applies its contents
-     * to the QApplication.
+     * to the target window, or the QApplication if there is none.
      *
      * @param name The human-readable name of the stylesheet to load.
      * @return true if the stylesheet was successfully loaded or cleared;
@@ -73,6 +117,9 @@ public:
      */
     QString currentStyleName() const;
 
+    /// Returns the durations of the switches applied so far.
+    const SwitchTiming &switchTiming() const { return timing; }
+
 private:
     /**
      * @brief Reads the contents of a stylesheet file.
@@ -83,11 +130,36 @@ private:
      * @param path Filesystem path to the .qss file.
      * @return The full text of the stylesheet, or empty if unreadable.
      */
-    QString readStyleSheetFile(const QString &path) const;
+    static QString readStyleSheetFile(const QString &path);
+
+    /**
+     * @brief Scans @p folderPath and saves the result as the catalogue at @p cachePath.
+     */
+    static QMap<QString, QString> scanCatalogue(const QString &folderPath, const QString &cachePath);
+
+    /**
+     * @brief Returns the text of stylesheet @p name, reading it only on first use.
+     */
+    QString styleSheetText(const QString &name);
+
+    /**
+     * @brief Starts reading the styles before and after @p name in the map.
+     */
+    void preloadNeighbours(const QString &name);
+
+    /**
+     * @brief Applies @p text to the target unless it is already in place, and times it.
+     */
+    void applyStyleSheet(const QString &text);
 
+    QPointer<QWidget> target;          /**< Window styled; null styles the whole application. */
+    QString appliedStyle;              /**< Stylesheet text currently in place. */
+    SwitchTiming timing;               /**< Durations of the switches so far. */
     QString loadedStyle;               /**< Raw contents of the last loaded stylesheet. */
     QMap<QString, QString> styleSheetMap; /**< Mapping of style names to .qss file paths. */
     QString currentStyle;              /**< Display name of the currently loaded style. */
+    QHash<QString, QString> styleSheetTexts; /**< Stylesheet texts read so far, by name. */
+    QHash<QString, QFuture<QString>> pendingStyleSheetTexts; /**< Background reads, by name. */
 };
 
 #endif // STYLEMANAGER_H
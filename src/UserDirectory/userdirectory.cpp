@@ -0,0 +1,80 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "userdirectory.h"
+
+void UserDirectory::insert(int id, const QString &name)
+{
+    auto existing = m_entries.constFind(id);
+    if (existing != m_entries.constEnd())
+        m_ids.remove(existing->name);
+
+    m_entries.insert(id, UserEntry{name, colorForName(name)});
+    m_ids.insert(name, id);
+} //insert
+
+int UserDirectory::idForName(const QString &name) const
+{
+    return m_ids.value(name, -1);
+} //idForName
+
+QString UserDirectory::name(int id) const
+{
+    auto it = m_entries.constFind(id);
+    return it != m_entries.constEnd() ? it->name : QString();
+} //name
+
+QColor UserDirectory::color(int id, const QColor &fallback) const
+{
+    auto it = m_entries.constFind(id);
+    return it != m_entries.constEnd() ? it->color : fallback;
+} //color
+
+void UserDirectory::clear()
+{
+    m_entries.clear();
+    m_ids.clear();
+} //clear
+
+QColor UserDirectory::colorForName(const QString &name)
+{
+    // deterministic hash → HSV color
+    QByteArray data = name.toUtf8();
+    size_t hash = qHash(data);
+
+    int hue = hash % 360;
+    int sat = 180 + (hash / 360 % 75);
+    int val = 200 + (hash / 10000 % 55);
+
+    return QColor::fromHsv(hue, sat, val);
+} //colorForName
+
+QByteArray UserDirectory::encodeName(const QString &name)
+{
+    QByteArray data = name.toUtf8();
+    if (data.size() <= kMaxEncodedNameBytes)
+        return data;
+
+    // Back up over continuation bytes (10xxxxxx) to the lead byte of the cut character.
+    qsizetype cut = kMaxEncodedNameBytes;
+    while (cut > 0 && (uchar(data.at(cut)) & 0xC0) == 0x80)
+        --cut;
+
+    data.truncate(cut);
+    return data;
+} //encodeName
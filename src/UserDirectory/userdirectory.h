@@ -0,0 +1,136 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef USERDIRECTORY_H
+#define USERDIRECTORY_H
+
+#include <QColor>
+#include <QHash>
+#include <QString>
+
+/**
+ * @struct UserEntry
+ * @brief Interned sender record shared by every message from the same user.
+ */
+struct UserEntry {
+    /**
+     * @brief The sender name. Copies handed out to messages share this buffer.
+     */
+    QString name;
+
+    /**
+     * @brief Display color derived once from the sender name.
+     */
+    QColor color;
+};
+
+/**
+ * @class UserDirectory
+ * @brief In-process interning table mapping sender ids to shared names and colors.
+ *
+ * UserDirectory mirrors the `users` table of the MessageStore. Each sender name is
+ * stored once and its display color is computed once on insertion, so fetching and
+ * rendering a message only costs an integer lookup instead of a string allocation
+ * and a hash of the name.
+ */
+class UserDirectory {
+public:
+    /**
+     * @brief Constructs an empty directory.
+     */
+    UserDirectory() = default;
+
+    /**
+     * @brief Registers a sender under the given database id.
+     *
+     * Re-inserting an existing id replaces its entry.
+     *
+     * @param id The id of the user row in the `users` table.
+     * @param name The sender name.
+     */
+    void insert(int id, const QString &name);
+
+    /**
+     * @brief Looks up the id assigned to a sender name.
+     * @param name The sender name.
+     * @return The user id, or -1 if the name has not been interned yet.
+     */
+    int idForName(const QString &name) const;
+
+    /**
+     * @brief Returns true if the id has been interned.
+     * @param id The user id.
+     */
+    bool contains(int id) const { return m_entries.contains(id); }
+
+    /**
+     * @brief Returns the shared name for a user id.
+     * @param id The user id.
+     * @return The interned name, or an empty string if unknown.
+     */
+    QString name(int id) const;
+
+    /**
+     * @brief Returns the precomputed display color for a user id.
+     * @param id The user id.
+     * @param fallback Color returned when the id is unknown.
+     * @return The interned color or @p fallback.
+     */
+    QColor color(int id, const QColor &fallback = QColor()) const;
+
+    /**
+     * @brief Removes every interned entry.
+     */
+    void clear();
+
+    /**
+     * @brief Returns the number of interned users.
+     */
+    int size() const { return m_entries.size(); }
+
+    /**
+     * @brief Generates a deterministic color for a given username.
+     *
+     * Uses a hash of the username to create a visually distinct and consistent color.
+     * This is the single source of user colors, called once per interned user.
+     *
+     * @param name The user name.
+     * @return A QColor derived from the hashed user name.
+     */
+    static QColor colorForName(const QString &name);
+
+    /// Longest encoded sender name, in UTF-8 bytes; stored names carry a 16-bit length.
+    static constexpr qsizetype kMaxEncodedNameBytes = 0xFFFF;
+
+    /**
+     * @brief Encodes a sender name as UTF-8, cut to at most kMaxEncodedNameBytes.
+     *
+     * The cut falls on a code point boundary, so an over-long name loses whole
+     * characters and never ends in a partial multi-byte sequence.
+     *
+     * @param name The sender name.
+     * @return The encoded, possibly shortened, name.
+     */
+    static QByteArray encodeName(const QString &name);
+
+private:
+    QHash<int, UserEntry> m_entries; /**< Interned entries keyed by user id. */
+    QHash<QString, int> m_ids;       /**< Reverse lookup from sender name to id. */
+};
+
+#endif // USERDIRECTORY_H
@@ -20,8 +20,8 @@
 
 #include <QApplication>
 #include <QSplashScreen>
+#include <QImageReader>
 #include <QPixmap>
-#include <QThread>
 #include <QWidget>
 
 int main(int argc, char *argv[])
@@ -30,17 +30,19 @@ int main(int argc, char *argv[])
     qputenv("QT_QPA_PLATFORM", "windows:darkmode=1");
 #endif
     QApplication a(argc, argv);
-    MainWindow w;
 
-    QPixmap pixmap(":/images/BackgroundImage10.png");
-    pixmap = pixmap.scaled(512,512,Qt::KeepAspectRatio);
+    // The reader scales while decoding; no full-size pixmap is made just to shrink it.
+    QImageReader reader(":/images/BackgroundImage10.png");
+    reader.setScaledSize(reader.size().scaled(512, 512, Qt::KeepAspectRatio));
+    const QPixmap pixmap = QPixmap::fromImage(reader.read());
 
+    // Up before the window is built, showing each startup stage as it begins.
     QSplashScreen splash(pixmap);
     splash.show();
     splash.raise();
 
-    splash.finish(&w);
-    QThread::msleep(1500);
+    MainWindow w(&splash);
     w.show();
+    splash.finish(&w);
     return a.exec();
 }
@@ -3,6 +3,7 @@
 
 #include <QString>
 #include <QDateTime>
+#include <QtGlobal>
 
 /**
  * @struct Message
@@ -11,8 +12,20 @@
  * Used for both storing messages in the database and rendering them in the UI.
  */
 struct Message {
+    /**
+     * @brief Database row id of the message, or 0 if it has not been stored.
+     */
+    qint64 id = 0;
+
+    /**
+     * @brief Id of the sender in the `users` table, or 0 if unknown.
+     */
+    int userId = 0;
+
     /**
      * @brief The name of the user who sent the message.
+     *
+     * Shares its buffer with the interned name in the UserDirectory.
      */
     QString user;
 
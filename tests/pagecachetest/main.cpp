@@ -0,0 +1,116 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Tests of the MessageStore page cache.
+ *
+ * The chat view asks for id-aligned pages that rarely start and end on stored
+ * ids; asking for the same page twice must be answered from memory.
+ */
+
+#include "src/MessageStore/messagestore.h"
+
+#include <QTemporaryDir>
+#include <QTest>
+#include <QTimeZone>
+
+#include <memory>
+
+class PageCacheTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void servesRepeatedRangeFromCache();
+    void servesEmptyRangeFromCache();
+    void refetchesTailRangeAfterInsert();
+
+private:
+    /// Opens a per-instance store in @p dir holding @p count messages.
+    static std::unique_ptr<MessageStore> openFilled(const QTemporaryDir &dir, int count);
+};
+
+std::unique_ptr<MessageStore> PageCacheTest::openFilled(const QTemporaryDir &dir, int count)
+{
+    std::unique_ptr<MessageStorage> storage(MessageStorage::create(MessageStorage::kSqliteBackend, dir.path(), 1, nullptr));
+    std::unique_ptr<MessageStore> store(dynamic_cast<MessageStore *>(storage.get()));
+    if (!store)
+        return nullptr;
+    storage.release();
+
+    if (!store->open())
+        return nullptr;
+
+    const QDateTime sent = QDateTime::fromSecsSinceEpoch(1700000000, QTimeZone::UTC);
+    for (int i = 0; i < count; ++i)
+        store->insertMessage("Alice", QString::number(i), sent.addSecs(i), false);
+    return store;
+}
+
+void PageCacheTest::servesRepeatedRangeFromCache()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const std::unique_ptr<MessageStore> store = openFilled(dir, 10);
+    QVERIFY(store);
+    const quint64 hits = store->pageCache().hits();
+    const quint64 misses = store->pageCache().misses();
+
+    // Page 0 of the pager: the range starts before the first id and ends past the last.
+    const MessageBatchPtr first = store->fetchMessageRange(0, 63);
+    const MessageBatchPtr second = store->fetchMessageRange(0, 63);
+
+    QCOMPARE(first->size(), 10);
+    QCOMPARE(second.get(), first.get());
+    QCOMPARE(store->pageCache().hits() - hits, quint64(1));
+    QCOMPARE(store->pageCache().misses() - misses, quint64(1));
+}
+
+void PageCacheTest::servesEmptyRangeFromCache()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const std::unique_ptr<MessageStore> store = openFilled(dir, 10);
+    QVERIFY(store);
+    const quint64 hits = store->pageCache().hits();
+
+    QCOMPARE(store->fetchMessageRange(1000, 1063)->size(), 0);
+    QCOMPARE(store->fetchMessageRange(1000, 1063)->size(), 0);
+    QCOMPARE(store->pageCache().hits() - hits, quint64(1));
+}
+
+void PageCacheTest::refetchesTailRangeAfterInsert()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const std::unique_ptr<MessageStore> store = openFilled(dir, 10);
+    QVERIFY(store);
+    QCOMPARE(store->fetchMessageRange(0, 63)->size(), 10);
+
+    store->insertMessage("Bob", "late", QDateTime::fromSecsSinceEpoch(1700001000, QTimeZone::UTC), false);
+    const quint64 hits = store->pageCache().hits();
+
+    QCOMPARE(store->fetchMessageRange(0, 63)->size(), 11);
+    QCOMPARE(store->pageCache().hits(), hits);
+}
+
+QTEST_GUILESS_MAIN(PageCacheTest)
+
+#include "main.moc"
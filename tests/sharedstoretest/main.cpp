@@ -0,0 +1,98 @@
+/*
+ * Chester The Chat
+ * Copyright (C) 2024 Timothy Millea
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Tests of the shared, deduplicating SQLite layout.
+ *
+ * Copies of one datagram stored by different instances must collapse into one
+ * row, while a sender repeating the same text must keep every message.
+ */
+
+#include "src/MessageStorage/messagestorage.h"
+
+#include <QTemporaryDir>
+#include <QTest>
+#include <QTimeZone>
+
+#include <memory>
+
+class SharedStoreTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void keepsRepeatedMessagesFromOneSender();
+    void collapsesCopiesFromOtherInstances();
+
+private:
+    /// Opens instance @p instanceID of the shared store in @p dir.
+    static std::unique_ptr<MessageStorage> openShared(const QTemporaryDir &dir, int instanceID);
+};
+
+std::unique_ptr<MessageStorage> SharedStoreTest::openShared(const QTemporaryDir &dir, int instanceID)
+{
+    std::unique_ptr<MessageStorage> store(MessageStorage::create(MessageStorage::kSharedBackend, dir.path(), instanceID, nullptr));
+    return store->open() ? std::move(store) : nullptr;
+}
+
+void SharedStoreTest::keepsRepeatedMessagesFromOneSender()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const std::unique_ptr<MessageStorage> store = openShared(dir, 1);
+    QVERIFY(store);
+
+    const QDateTime sent = QDateTime::fromSecsSinceEpoch(1700000000, QTimeZone::UTC);
+    const qint64 firstId = store->insertMessage("Alice", "ok", sent, false);
+    const qint64 secondId = store->insertMessage("Alice", "ok", sent.addMSecs(500), false);
+
+    QVERIFY(firstId > 0);
+    QVERIFY(secondId > firstId);
+    QCOMPARE(store->messageCount(), 2);
+
+    const MessageBatchPtr batch = store->fetchMessageRange(firstId, secondId);
+    QCOMPARE(batch->size(), 2);
+    QCOMPARE(batch->text(0).toString(), QStringLiteral("ok"));
+    QCOMPARE(batch->text(1).toString(), QStringLiteral("ok"));
+}
+
+void SharedStoreTest::collapsesCopiesFromOtherInstances()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const std::unique_ptr<MessageStorage> first = openShared(dir, 1);
+    const std::unique_ptr<MessageStorage> second = openShared(dir, 2);
+    QVERIFY(first);
+    QVERIFY(second);
+
+    const QDateTime sent = QDateTime::fromSecsSinceEpoch(1700000000, QTimeZone::UTC);
+    const qint64 storedId = first->insertMessage("Alice", "ok", sent, false);
+    const qint64 linkedId = second->insertMessage("Alice", "ok", sent.addMSecs(300), false);
+    const qint64 repeatId = second->insertMessage("Alice", "ok", sent.addMSecs(600), false);
+
+    QVERIFY(storedId > 0);
+    QCOMPARE(linkedId, storedId); // the same datagram, received by both instances
+    QVERIFY(repeatId > storedId);  // a second "ok" the first instance has not seen yet
+    QCOMPARE(first->messageCount(), 1);
+    QCOMPARE(second->messageCount(), 2);
+}
+
+QTEST_GUILESS_MAIN(SharedStoreTest)
+
+#include "main.moc"
@@ -3,7 +3,6 @@
 
 //MINOR FEATURES
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-//TODO - Last read bookmark in chat window
 
 //MAJOR FEATURES
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~